@@ -11,7 +11,11 @@ bool m_formatsInitialized = false;
 
 extern std::vector<std::string> defaultSearchPaths;
 
-void GBuffer::resize(nvvk::AllocatorDedicated* allocator, vk::Device device, uint32_t graphicsQueueIndex, vk::Extent2D extent, vk::RenderPass& pass) {
+vk::ImageCreateInfo GBuffer::imageCreateInfo(vk::Extent2D extent) {
+	return nvvk::makeImage2DCreateInfo(extent, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage);
+}
+
+void GBuffer::resize(nvvk::AllocatorDma* allocator, vk::Device device, uint32_t graphicsQueueIndex, vk::Extent2D extent, vk::RenderPass& pass) {
 	m_allocator = allocator;
 	m_device = device;
 	m_graphicsQueueIndex = graphicsQueueIndex;
@@ -27,8 +31,7 @@ void GBuffer::resize(nvvk::AllocatorDedicated* allocator, vk::Device device, uin
 	vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
 
 	vk::SamplerCreateInfo samplerCreateInfo{ {}, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest };
-	vk::ImageCreateInfo imageCreateInfo =
-		nvvk::makeImage2DCreateInfo(extent, vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage);
+	vk::ImageCreateInfo imageCreateInfo = GBuffer::imageCreateInfo(extent);
 	{
 		nvvk::Image             image = allocator->createImage(imageCreateInfo);
 		vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
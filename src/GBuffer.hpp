@@ -28,12 +28,16 @@ public:
 	}
 
 
+	// albedo, normal, material properties and world position, all of the same format
+	static constexpr uint32_t imageCount = 4;
+	static vk::ImageCreateInfo imageCreateInfo(vk::Extent2D extent);
+
 	void transitionLayout();
 
-	void resize(nvvk::AllocatorDedicated* allocator, vk::Device device, uint32_t graphicsQueueIndex, vk::Extent2D extent, vk::RenderPass& pass);
+	void resize(nvvk::AllocatorDma* allocator, vk::Device device, uint32_t graphicsQueueIndex, vk::Extent2D extent, vk::RenderPass& pass);
 
 	[[nodiscard]] void create(
-		nvvk::AllocatorDedicated* allocator, vk::Device device, uint32_t graphicsQueueIndex, vk::Extent2D bufferExtent, vk::RenderPass& pass
+		nvvk::AllocatorDma* allocator, vk::Device device, uint32_t graphicsQueueIndex, vk::Extent2D bufferExtent, vk::RenderPass& pass
 	) {
 		resize(allocator, device, graphicsQueueIndex, bufferExtent, pass);
 	}
@@ -42,7 +46,7 @@ public:
 private:
 	vk::Device m_device;
 	uint32_t   m_graphicsQueueIndex;
-	nvvk::AllocatorDedicated* m_allocator;
+	nvvk::AllocatorDma* m_allocator;
 
 	nvvk::Texture m_albedoTexture;
 	nvvk::Texture m_normalTexture;
@@ -5,6 +5,11 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <map>
 namespace fs = std::filesystem;
 
 extern std::vector<std::string> defaultSearchPaths;
@@ -30,6 +35,14 @@ extern bool IgnorePointLight;
 
 #include "nvh/alignment.hpp"
 #include "shaders/headers/binding.glsl"
+#include "shaders/headers/DebugConstants.glsl"
+#include "pfm.h"
+
+static uint32_t lightCellCount(vk::Extent2D size) {
+	uint32_t tilesX = (size.width + LIGHT_CULLING_TILE_SIZE - 1) / LIGHT_CULLING_TILE_SIZE;
+	uint32_t tilesY = (size.height + LIGHT_CULLING_TILE_SIZE - 1) / LIGHT_CULLING_TILE_SIZE;
+	return tilesX * tilesY * LIGHT_CULLING_SLICES;
+}
 
 
 void App::setup(const vk::Instance& instance,
@@ -38,56 +51,163 @@ void App::setup(const vk::Instance& instance,
 	uint32_t                  queueFamily)
 {
 	AppBase::setup(instance, device, physicalDevice, queueFamily);
-	m_alloc.init(device, physicalDevice);
+	m_memAllocator.init(device, physicalDevice);
+	// the vertex, index, scratch and instance buffers are read through their device address
+	m_memAllocator.setAllocateFlags(VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT, true);
+	m_alloc.init(device, physicalDevice, &m_memAllocator);
+	m_transientMemory.setup(device, physicalDevice);
 	m_debug.setup(m_device);
+	startupTrace.setupGpu(device, physicalDevice);
 }
 
 void App::createScene(std::string scene) {
+	StartupTrace::Zone sceneZone("App::createScene");
 	std::string filename = nvh::findFile(scene, defaultSearchPaths);
-	_loadScene(filename);
+	{
+		StartupTrace::Zone zone("Scene Parse");
+		_loadScene(filename);
+	}
 	if (IgnorePointLight) {
 		m_gltfScene.m_lights.clear();
 	}
 	_createDescriptorPool();
 
-	m_sceneBuffers.create(
-		m_gltfScene,
-		m_tmodel, &m_alloc, m_device, m_physicalDevice,
-		m_graphicsQueueIndex
-	);
+	{
+		StartupTrace::Zone zone("SceneBuffers::create");
+		m_sceneBuffers.create(
+			m_gltfScene,
+			m_tmodel, &m_alloc, m_device, m_physicalDevice,
+			m_graphicsQueueIndex
+		);
+	}
 
 	m_sceneBuffers.createDescriptorSet(m_descStaticPool);
 
-	for (std::size_t i = 0; i < numGBuffers; i++) {
-		m_gBuffers[i].create(&m_alloc, m_device, m_graphicsQueueIndex, m_size, m_renderPass);
-		//m_gBuffers[i].transitionLayout();
+	{
+		StartupTrace::Zone zone("G-Buffer Allocation");
+		for (std::size_t i = 0; i < numGBuffers; i++) {
+			m_gBuffers[i].create(&m_alloc, m_device, m_graphicsQueueIndex, m_size, m_renderPass);
+			//m_gBuffers[i].transitionLayout();
+		}
 	}
 
 	const float aspectRatio = m_size.width / static_cast<float>(m_size.height);
 	m_sceneUniforms.prevFrameProjectionViewMatrix = CameraManip.getMatrix() * nvmath::perspectiveVK(CameraManip.getFov(), aspectRatio, 0.1f, 1000.0f);
 
 	_createUniformBuffer();
+	{
+		StartupTrace::Zone zone("Render Target Allocation");
+		_createRenderTargets();
+	}
 	_createDescriptorSet();
+	{
+		StartupTrace::Zone zone("World Grid Allocation");
+		_createWorldGrid();
+	}
 
-	LOGI("Create Restir Pass\n");
+	auto features = m_physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+	m_supportsFloat16 = features.get<vk::PhysicalDeviceVulkan12Features>().shaderFloat16;
+	auto properties = m_physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+	const auto& subgroup = properties.get<vk::PhysicalDeviceSubgroupProperties>();
+	vk::ShaderStageFlags statsStages = vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eCompute;
+	vk::SubgroupFeatureFlags statsOperations = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eArithmetic;
+	m_supportsPipelineStats = (subgroup.supportedStages & statsStages) == statsStages
+		&& (subgroup.supportedOperations & statsOperations) == statsOperations;
+	// the frames are synchronized with a timeline semaphore, core in Vulkan 1.2 and enabled with the other 1.2 features
+	assert(features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore);
+
+	m_shaderReloader.setup({
+		"src/shaders/restir.rgen", "src/shaders/restir.rmiss", "src/shaders/restirShadow.rmiss", "src/shaders/restir.rchit",
+		"src/shaders/spatialReuse.comp", "src/shaders/giSpatialReuse.comp", "src/shaders/shade.comp",
+		"src/shaders/denoiseTemporal.comp", "src/shaders/denoiseAtrous.comp",
+		"src/shaders/lightCullingBin.comp", "src/shaders/lightCullingBuild.comp", "src/shaders/lightPresample.comp",
+		"src/shaders/worldGrid.comp",
+		"src/shaders/quad.vert", "src/shaders/post.frag" });
+	// the statistics counters of the shaders reduce in the subgroup, without subgroup arithmetic the pipelines
+	// are created from the variant doing plain atomics
+	if (!m_supportsPipelineStats) {
+		std::vector<std::string> reloaded;
+		if (!m_shaderReloader.isSupported()
+			|| !_useShaderVariant("SUBGROUP_ARITHMETIC", "0", "nosubgroup", "1", "", reloaded)) {
+			LOGW("No subgroup arithmetic in raygen and compute and no shader variant without it\n");
+		}
+	}
 
-	m_restirPass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
-	m_restirPass.createRenderPass(m_size);
-	m_restirPass.createPipeline(m_sceneSetLayout, m_sceneBuffers.getDescLayout(), m_lightSetLayout, m_restirSetLayout);
+	{
+		StartupTrace::Zone pipelinesZone("Pipeline Creation");
+		{
+			StartupTrace::Zone zone("Restir Pass");
+			LOGI("Create Restir Pass\n");
+			m_restirPass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
+			m_restirPass.createRenderPass(m_size);
+			m_restirPass.createPipeline(m_sceneSetLayout, m_sceneBuffers.getDescLayout(), m_lightSetLayout, m_restirSetLayout);
+		}
 
+		{
+			StartupTrace::Zone zone("SpatialReuse Pass");
+			LOGI("Create SpatialReuse Pass\n");
+			m_spatialReusePass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
+			m_spatialReusePass.createRenderPass(m_size);
+			m_spatialReusePass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+		}
 
-	LOGI("Create SpatialReuse Pass\n");
+		{
+			StartupTrace::Zone zone("GI SpatialReuse Pass");
+			LOGI("Create GI SpatialReuse Pass\n");
+			m_giSpatialReusePass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
+			m_giSpatialReusePass.createRenderPass(m_size);
+			m_giSpatialReusePass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+		}
 
-	m_spatialReusePass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
-	m_spatialReusePass.createRenderPass(m_size);
-	m_spatialReusePass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+		{
+			StartupTrace::Zone zone("Shade Pass");
+			LOGI("Create Shade Pass\n");
+			m_shadePass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
+			m_shadePass.createRenderPass(m_size);
+			m_shadePass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+		}
+
+		{
+			StartupTrace::Zone zone("Denoise Pass");
+			LOGI("Create Denoise Pass\n");
+			m_denoisePass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
+			m_denoisePass.createRenderPass(m_size);
+			m_denoisePass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+		}
+
+		{
+			StartupTrace::Zone zone("Light Culling Pass");
+			LOGI("Create Light Culling Pass\n");
+			m_lightCullingPass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
+			m_lightCullingPass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+		}
+
+		{
+			StartupTrace::Zone zone("Light Presample Pass");
+			LOGI("Create Light Presample Pass\n");
+			m_lightPresamplePass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
+			m_lightPresamplePass.createPipeline(m_sceneSetLayout, m_lightSetLayout);
+		}
+
+		{
+			StartupTrace::Zone zone("World Grid Pass");
+			LOGI("Create World Grid Pass\n");
+			m_worldGridPass.setup(m_device, m_physicalDevice, m_graphicsQueueIndex, &m_alloc);
+			m_worldGridPass.createPipeline(m_sceneSetLayout, m_lightSetLayout);
+		}
+	}
+
+	m_gpuTimer.setup(m_device, m_physicalDevice, 16);
 
 
 	createDepthBuffer();
 	createRenderPass();
 	initGUI(0);
 	createFrameBuffers();
-	_createPostPipeline();
+	{
+		StartupTrace::Zone zone("Post Pipeline");
+		_createPostPipeline();
+	}
 
 	_updateRestirDescriptorSet();
 
@@ -95,6 +215,8 @@ void App::createScene(std::string scene) {
 	_createMainCommandBuffer();
 
 	m_device.waitIdle();
+	// the startup is over, the trace keeps its events until it is written
+	startupTrace.destroyGpu();
 	LOGI("Prepared\n");
 
 
@@ -116,12 +238,50 @@ void App::_renderUI() {
 			"Roughness",
 			"Metallic",
 			"WorldPosition",
-			"Point Light Visualization"
+			"Point Light Visualization",
+			"World Grid Occupancy",
+			"P-Hat FP16 Error",
+			"Shader Cost"
 		};
-		changed |= ImGui::Combo("Debug Mode", &m_sceneUniforms.debugMode, debugModes, 8);
+		changed |= ImGui::Combo("Debug Mode", &m_sceneUniforms.debugMode, debugModes, 11);
+		if (m_sceneUniforms.debugMode == DEBUG_SHADER_COST) {
+			const char* costPhases[]{ "Primary Ray", "Candidates", "Visibility", "Temporal", "Spatial", "All" };
+			changed |= ImGui::Combo("Cost Phase", &m_sceneUniforms.shaderCostPhase, costPhases, SHADER_COST_PHASES + 1);
+			changed |= ImGui::SliderFloat("Cost Scale (cycles)", &m_sceneUniforms.shaderCostScale, 1000.0f, 10000000.0f, "%.0f", 4.0f);
+			if (ImGui::Button("Export Cost Histogram")) {
+				m_exportShaderCost = true;
+			}
+		}
+		if (m_sceneUniforms.debugMode == DEBUG_PHAT_HALF_ERROR && m_pHatErrorSamples > 0) {
+			ImGui::Text("Relative Error: mean %.2e, max %.2e", m_pHatErrorMean, m_pHatErrorMax);
+			ImGui::Text("Rounded to Zero: %u / %u samples", m_pHatErrorZeroed, m_pHatErrorSamples);
+		}
 		changed |= ImGui::SliderFloat("Gamma", &m_sceneUniforms.gamma, 1.0f, 5.0f);
 
 		changed |= ImGui::SliderInt("Initial Light Samples (log2)", &m_log2InitialLightSamples, 0, 10);
+		changed |= ImGui::Checkbox("Adaptive Candidates", &m_enableAdaptiveCandidates);
+		if (m_enableAdaptiveCandidates) {
+			ImGui::Text("Average Candidates / Pixel: %.2f", m_averageCandidates);
+		}
+		const char* generationModes[]{
+			"Full",
+			"Checkerboard",
+			"Quarter"
+		};
+		changed |= ImGui::Combo("Reservoir Generation", &m_sceneUniforms.generationMode, generationModes, 3);
+		changed |= ImGui::Checkbox("Light Presampling", &m_enableLightPresampling);
+		changed |= ImGui::Checkbox("World Grid", &m_enableWorldGrid);
+		if (m_enableWorldGrid) {
+			m_worldGridDirty |= ImGui::SliderFloat("Grid Cell Size", &m_sceneUniforms.worldGridCellSize, 0.01f, 10.0f, "%.3f", 3.0f);
+			m_worldGridDirty |= ImGui::SliderInt("Grid Cells (log2)", &m_log2WorldGridCells, 10, 20);
+			m_worldGridDirty |= ImGui::SliderInt("Reservoirs / Cell", reinterpret_cast<int*>(&m_sceneUniforms.worldGridReservoirsPerCell), 1, 64);
+		}
+		if (m_sceneUniforms.pointLightCount > 0) {
+			changed |= ImGui::Checkbox("Light Culling", &m_enableLightCulling);
+			if (m_enableLightCulling) {
+				changed |= ImGui::SliderFloat("Light Influence Threshold", &m_sceneUniforms.lightInfluenceThreshold, 0.0001f, 1.0f, "%.4f", 3.0f);
+			}
+		}
 
 		changed |= ImGui::Checkbox("Use Temporal Reuse", &m_enableTemporalReuse);
 		if (m_enableTemporalReuse) {
@@ -130,8 +290,31 @@ void App::_renderUI() {
 		changed |= ImGui::Checkbox("Use Spatial Reuse", &m_enableSpatialReuse);
 		if (m_enableSpatialReuse) {
 			changed |= ImGui::SliderFloat("Spatial Radius", &m_sceneUniforms.spatialRadius, 0, 50);
+			changed |= ImGui::SliderInt("Spatial Neighbors", reinterpret_cast<int*>(&m_sceneUniforms.spatialNeighbors), 0, 8);
+		}
+		if (m_spatialReusePass.supportsSubgroupSharing()) {
+			changed |= ImGui::Checkbox("Subgroup Neighbor Sharing", &m_enableSubgroupSpatialReuse);
 		}
 		changed |= ImGui::Checkbox("Use Visible Test", &m_enableVisibleTest);
+		changed |= ImGui::Checkbox("Indirect Illumination (ReSTIR GI)", &m_enableGI);
+		if (m_shaderReloader.isSupported()) {
+			const char* reservoirSizes[]{ "1", "2", "4", "8" };
+			int reservoirSizeIndex = int(std::log2(m_requestedReservoirSize));
+			if (ImGui::Combo("Samples / Reservoir", &reservoirSizeIndex, reservoirSizes, 4)) {
+				m_requestedReservoirSize = 1 << reservoirSizeIndex;
+			}
+			if (m_supportsFloat16) {
+				ImGui::Checkbox("FP16 Target Function", &m_requestedHalfPrecisionPHat);
+			}
+		}
+		changed |= ImGui::Checkbox("Use Denoiser", &m_enableDenoiser);
+		if (m_enableDenoiser) {
+			changed |= ImGui::SliderInt("A-Trous Iterations", &m_sceneUniforms.denoiseIterations, 1, 5);
+			changed |= ImGui::SliderFloat("Temporal Alpha", &m_sceneUniforms.denoiseTemporalAlpha, 0.01f, 1.0f);
+			changed |= ImGui::SliderFloat("Luminance Phi", &m_sceneUniforms.denoisePhiLuminance, 0.1f, 16.0f);
+			changed |= ImGui::SliderFloat("Normal Phi", &m_sceneUniforms.denoisePhiNormal, 1.0f, 256.0f);
+			changed |= ImGui::SliderFloat("Position Phi", &m_sceneUniforms.denoisePhiPosition, 0.01f, 2.0f);
+		}
 		changed |= ImGui::Checkbox("Use Environment", &m_enableEnvironment);
 		if (m_enableEnvironment) {
 			changed |= ImGui::SliderFloat("FireFly Clamp Threshold", &m_sceneUniforms.fireflyClampThreshold, 0.0, 5.0);
@@ -155,6 +338,149 @@ void App::_renderUI() {
 
 			}
 		}
+		if (ImGui::CollapsingHeader("Camera Path"))
+		{
+			ImGui::InputText("File", m_cameraPathFile, sizeof(m_cameraPathFile));
+			if (!m_playingPath) {
+				if (!m_recordingPath && ImGui::Button("Record")) {
+					m_cameraPath.clear();
+					m_recordingPath = true;
+					m_pathRecordStart = std::chrono::steady_clock::now();
+				}
+				else if (m_recordingPath && ImGui::Button("Stop Recording")) {
+					m_recordingPath = false;
+					m_cameraPath.save(m_cameraPathFile);
+				}
+			}
+			if (!m_recordingPath) {
+				if (!m_playingPath && ImGui::Button("Play")) {
+					if (m_cameraPath.load(m_cameraPathFile)) {
+						m_playingPath = true;
+						m_pathFrame = 0;
+						// same checkerboard phases on every playback
+						m_sceneUniforms.frameIndex = 0;
+						_resetFrame();
+					}
+				}
+				else if (m_playingPath && ImGui::Button("Stop")) {
+					m_playingPath = false;
+				}
+				ImGui::Checkbox("Loop", &m_loopPath);
+				ImGui::SliderFloat("Timestep (s)", &m_pathTimestep, 1.0f / 240.0f, 1.0f / 10.0f, "%.4f");
+			}
+			ImGui::Text("%zu keyframes, %.2f s", m_cameraPath.size(), m_cameraPath.getDuration());
+		}
+		if (ImGui::CollapsingHeader("Acceleration Structures"))
+		{
+			const AsBuilder::Stats& asStats = m_sceneBuffers.getAsStats();
+			ImGui::Text("BLAS: %u (%u batches)", asStats.blasCount, asStats.batchCount);
+			ImGui::Text("BLAS Memory: %.2f MB -> %.2f MB (compacted)",
+				asStats.uncompactedBlasBytes / (1024.0f * 1024.0f), asStats.compactedBlasBytes / (1024.0f * 1024.0f));
+			ImGui::Text("TLAS Memory: %.2f MB", asStats.tlasBytes / (1024.0f * 1024.0f));
+			ImGui::Text("Build Scratch: %.2f MB", asStats.scratchBytes / (1024.0f * 1024.0f));
+			ImGui::Text("Peak: %.2f MB  Steady: %.2f MB",
+				asStats.peakBytes / (1024.0f * 1024.0f), asStats.steadyBytes / (1024.0f * 1024.0f));
+		}
+		if (ImGui::CollapsingHeader("Resolution"))
+		{
+			if (ImGui::Checkbox("Dynamic Resolution", &m_enableDynamicResolution) && m_enableDynamicResolution) {
+				m_resolutionController.reset(m_renderScale);
+			}
+			if (m_enableDynamicResolution) {
+				ImGui::SliderFloat("Target GPU Time (ms)", &m_resolutionController.m_targetMs, 2.0f, 50.0f);
+				ImGui::SliderFloat("Minimum Scale", &m_resolutionController.m_minScale, 0.25f, 1.0f);
+				ImGui::Text("Smoothed GPU Time: %.2f ms", m_resolutionController.getSmoothedMs());
+			}
+			else {
+				ImGui::SliderFloat("Render Scale", &m_renderScale, 0.25f, 1.0f);
+			}
+			ImGui::Text("Render Size: %u x %u (%.0f%%)", m_renderSize.width, m_renderSize.height, m_renderScale * 100.0f);
+		}
+		if (ImGui::CollapsingHeader("Memory"))
+		{
+			const float mb = 1024.0f * 1024.0f;
+			MemoryStats memStats = _collectMemoryStats();
+			ImGui::Text("Geometry: %.2f MB", memStats.geometry / mb);
+			ImGui::Text("Textures: %.2f MB", memStats.textures / mb);
+			ImGui::Text("Acceleration Structures: %.2f MB", memStats.accelerationStructures / mb);
+			ImGui::Text("G-Buffer: %.2f MB", memStats.gBuffer / mb);
+			ImGui::Text("Reservoirs: %.2f MB", memStats.reservoirs / mb);
+			ImGui::Text("Render Targets: %.2f MB", memStats.renderTargets / mb);
+			ImGui::Text("Transient: %.2f MB (%.2f MB unaliased)", memStats.transient / mb, memStats.transientUnaliased / mb);
+			ImGui::Text("Total: %.2f MB", memStats.total() / mb);
+			ImGui::Text("Blocks: %.2f MB allocated, %.2f MB used",
+				memStats.allocatedBlockBytes / mb, memStats.usedBlockBytes / mb);
+			for (const MemoryStats::WorkingSet& workingSet : memStats.workingSets) {
+				ImGui::Text("Targets at %up: %.0f MB, %.0f MB aliased", workingSet.extent.height,
+					workingSet.bytes / mb, workingSet.aliasedBytes / mb);
+			}
+			for (std::size_t i = 0; i < memStats.heaps.size(); ++i) {
+				const MemoryStats::Heap& heap = memStats.heaps[i];
+				if (memStats.budgetSupported) {
+					ImGui::Text("Heap %zu%s: %.0f / %.0f MB (size %.0f MB)", i, heap.deviceLocal ? " (device)" : "",
+						heap.usage / mb, heap.budget / mb, heap.size / mb);
+				}
+				else {
+					ImGui::Text("Heap %zu%s: size %.0f MB", i, heap.deviceLocal ? " (device)" : "", heap.size / mb);
+				}
+			}
+		}
+		if (ImGui::CollapsingHeader("Shaders"))
+		{
+			if (m_shaderReloader.isSupported()) {
+				ImGui::Checkbox("Hot Reload", &m_enableShaderReload);
+				if (ImGui::Button("Reload All")) {
+					m_forceShaderReload = true;
+				}
+			}
+			else {
+				ImGui::Text("Hot reload needs shaderc");
+			}
+			if (!m_shaderReloader.getLastError().empty()) {
+				ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Compile error, previous pipeline kept:");
+				ImGui::TextWrapped("%s", m_shaderReloader.getLastError().c_str());
+			}
+		}
+		if (ImGui::CollapsingHeader("GPU Timings"))
+		{
+			for (const auto& time : m_gpuTimer.getTimes()) {
+				ImGui::Text("%s: %.3f ms", time.first.c_str(), time.second);
+			}
+			ImGui::Text("Total: %.3f ms", m_gpuTimer.getTotal());
+			ImGui::Text("Barriers: %u", m_renderGraph.getBarrierCount());
+			ImGui::Text("CPU wait: %.3f ms, latency: %.3f ms", m_frameWaitMs, m_frameLatencyMs);
+		}
+		if (ImGui::CollapsingHeader("Pipeline Statistics"))
+		{
+			if (m_supportsPipelineStats) {
+				ImGui::Checkbox("Count", &m_enablePipelineStats);
+			}
+			else {
+				ImGui::Text("Counting needs subgroup arithmetic in ray generation shaders");
+			}
+			if (m_enablePipelineStats && m_pipelineStatsFrame > 0) {
+				const shader::PipelineStats& stats = m_pipelineStats;
+				auto percent = [](uint32_t count, uint32_t total) {
+					return total > 0 ? 100.0f * float(count) / float(total) : 0.0f;
+				};
+				ImGui::Text("Frame %llu", static_cast<unsigned long long>(m_pipelineStatsFrame));
+				ImGui::Text("Temporal: %u pixels, %.1f%% offscreen", stats.temporalTested,
+					percent(stats.temporalOffscreen, stats.temporalTested));
+				ImGui::Text("Rejected by position %.1f%%, albedo %.1f%%, normal %.1f%%",
+					percent(stats.temporalPositionRejected, stats.temporalTested),
+					percent(stats.temporalAlbedoRejected, stats.temporalTested),
+					percent(stats.temporalNormalRejected, stats.temporalTested));
+				ImGui::Text("Spatial: %u of %u neighbors merged (%.1f%%)", stats.spatialMerged, stats.spatialTested,
+					percent(stats.spatialMerged, stats.spatialTested));
+				ImGui::Text("Shadow rays: %u, %.1f%% occluded", stats.shadowRays,
+					percent(stats.shadowRaysOccluded, stats.shadowRays));
+				float mHistogram[PIPELINE_STATS_M_BINS];
+				for (int i = 0; i < PIPELINE_STATS_M_BINS; ++i) {
+					mHistogram[i] = float(stats.mHistogram[i]);
+				}
+				ImGui::PlotHistogram("M (log2)", mHistogram, PIPELINE_STATS_M_BINS, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+			}
+		}
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
 			1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
 		ImGuiH::Control::Info("", "", "(F10) Toggle Pane", ImGuiH::Control::Flags::Disabled);
@@ -168,15 +494,40 @@ void App::_renderUI() {
 
 
 void App::render() {
+	_updateCameraPath();
 	_updateFrame();
-	m_queue.waitIdle();
+	_waitForFrame(m_submittedFrames);
+	_readCandidateStats();
+	_readPipelineStats();
+	_readPHatErrorStats();
+	if (m_exportShaderCost) {
+		_exportShaderCost("shader_cost.json");
+		m_exportShaderCost = false;
+	}
+	_resolveGpuTimer();
+	_updateRenderSize(false);
+	_reloadShaders(m_forceShaderReload);
+	m_forceShaderReload = false;
+	if (uint32_t(m_requestedReservoirSize) != m_reservoirSize && !_setReservoirSize(m_requestedReservoirSize)) {
+		m_requestedReservoirSize = int(m_reservoirSize);
+	}
+	if (m_requestedHalfPrecisionPHat != m_halfPrecisionPHat && !_setHalfPrecisionPHat(m_requestedHalfPrecisionPHat)) {
+		m_requestedHalfPrecisionPHat = m_halfPrecisionPHat;
+	}
+	if (m_worldGridDirty) {
+		// the light set is still bound by the frame command buffer of the previous frame
+		m_device.waitIdle();
+		_destroyWorldGrid();
+		_createWorldGrid();
+		_resetFrame();
+		m_worldGridDirty = false;
+	}
 
 	{
 		const vk::CommandBuffer& cmdBuf = m_mainCommandBuffer;
 		cmdBuf.begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-		_updateUniformBuffer(cmdBuf);
-		m_restirPass.run(cmdBuf, m_sceneSet, m_sceneBuffers.getDescSet(), m_lightSet, m_restirSets[m_currentGBufferFrame]);
-		m_spatialReusePass.run(cmdBuf, m_sceneSet, m_lightSet, m_restirSets[m_currentGBufferFrame]);
+		m_gpuTimer.reset(cmdBuf);
+		_recordFrame(cmdBuf);
 		cmdBuf.end();
 		_submitMainCommand();
 
@@ -206,11 +557,10 @@ void App::render() {
 		postRenderPassBeginInfo.setRenderArea({ {}, getSize() });
 
 		cmdBuf.beginRenderPass(postRenderPassBeginInfo, vk::SubpassContents::eInline);
-		cmdBuf.pushConstants<shader::PushConstant>(m_postPipelineLayout,
-			vk::ShaderStageFlagBits::eFragment,
-			0, m_pushC);
 		// Rendering tonemapper
+		m_gpuTimer.begin(cmdBuf, "post");
 		_drawPost(cmdBuf, m_currentGBufferFrame);
+		m_gpuTimer.end(cmdBuf);
 		// Rendering UI
 		ImGui::Render();
 		ImGui::RenderDrawDataVK(cmdBuf, ImGui::GetDrawData());
@@ -228,12 +578,190 @@ void App::render() {
 	}
 }
 
+//--------------------------------------------------------------------------------------------------
+// Records the passes of a frame, the render graph places the barriers between them from what they access
+//
+void App::_recordFrame(const vk::CommandBuffer& cmdBuf) {
+	using vkAF = vk::AccessFlagBits;
+	using vkPS = vk::PipelineStageFlagBits;
+	uint32_t frame = m_currentGBufferFrame;
+	uint32_t prevFrame = (numGBuffers + frame - 1) % numGBuffers;
+	vk::Buffer ubo = m_sceneUniformBuffer.buffer;
+	const GBuffer& gBuf = m_gBuffers[frame];
+	const GBuffer& prevGBuf = m_gBuffers[prevFrame];
+	auto readGBuffer = [](RenderGraph::PassBuilder& pass, const GBuffer& buf) {
+		pass.read(buf.getWorldPosTexture().image)
+			.read(buf.getAlbedoTexture().image)
+			.read(buf.getNormalTexture().image)
+			.read(buf.getMaterialPropertiesTexture().image);
+	};
+
+	m_renderGraph.addPass("uniforms", vkPS::eTransfer, [this](const vk::CommandBuffer& cmdBuf) {
+		_updateUniformBuffer(cmdBuf);
+	}, false)
+		.write(ubo, vkAF::eTransferWrite);
+	// the pipeline statistics count from zero each frame
+	if (m_enablePipelineStats) {
+		m_renderGraph.addPass("pipelineStatsClear", vkPS::eTransfer, [this](const vk::CommandBuffer& cmdBuf) {
+			cmdBuf.fillBuffer(m_pipelineStatsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+		}, false)
+			.write(m_pipelineStatsBuffer.buffer, vkAF::eTransferWrite);
+	}
+	// pixels without a primary hit or without candidates keep no cost
+	if (m_sceneUniforms.debugMode == DEBUG_SHADER_COST) {
+		m_renderGraph.addPass("shaderCostClear", vkPS::eTransfer, [this](const vk::CommandBuffer& cmdBuf) {
+			vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, SHADER_COST_LAYERS };
+			cmdBuf.clearColorImage(m_shaderCostImage.image, vk::ImageLayout::eGeneral,
+				vk::ClearColorValue(std::array<uint32_t, 4>{ 0, 0, 0, 0 }), range);
+		}, false)
+			.write(m_shaderCostImage.image, vk::ImageLayout::eGeneral, vkAF::eTransferWrite);
+	}
+
+	if (m_enableLightCulling && m_sceneUniforms.pointLightCount > 0) {
+		m_renderGraph.addPass("lightCulling", vkPS::eTransfer | vkPS::eComputeShader, [this, frame](const vk::CommandBuffer& cmdBuf) {
+			m_lightCullingPass.run(cmdBuf, m_sceneSet, m_lightSet, m_restirSets[frame],
+				m_lightCellCountBuffer.buffer, m_lightCellEntryBuffer.buffer, lightCellCount(m_renderSize), m_sceneUniforms.pointLightCount);
+		})
+			.read(ubo, vkAF::eUniformRead)
+			.write(m_lightCellCountBuffer.buffer, vkAF::eTransferWrite | vkAF::eShaderRead | vkAF::eShaderWrite)
+			.write(m_lightCellEntryBuffer.buffer, vkAF::eTransferWrite | vkAF::eShaderRead | vkAF::eShaderWrite);
+	}
+	if (m_enableWorldGrid && !m_enableEnvironment) {
+		m_renderGraph.addPass("worldGrid", vkPS::eComputeShader, [this](const vk::CommandBuffer& cmdBuf) {
+			m_worldGridPass.run(cmdBuf, m_sceneSet, m_lightSet, m_sceneUniforms.worldGridCellCount * m_sceneUniforms.worldGridReservoirsPerCell);
+		})
+			.read(ubo, vkAF::eUniformRead)
+			.readWrite(m_worldGridCellBuffer.buffer)
+			.readWrite(m_worldGridReservoirBuffer.buffer);
+	}
+	if (m_enableLightPresampling && !m_enableEnvironment) {
+		m_renderGraph.addPass("lightPresample", vkPS::eComputeShader, [this](const vk::CommandBuffer& cmdBuf) {
+			m_lightPresamplePass.run(cmdBuf, m_sceneSet, m_lightSet);
+		})
+			.read(ubo, vkAF::eUniformRead)
+			.write(m_presampledLightBuffer.buffer);
+	}
+
+	auto restir = m_renderGraph.addPass("restir", vkPS::eRayTracingShaderKHR, [this, frame](const vk::CommandBuffer& cmdBuf) {
+		m_restirPass.run(cmdBuf, m_sceneSet, m_sceneBuffers.getDescSet(), m_lightSet, m_restirSets[frame], m_sceneUniforms.generationMode);
+	});
+	restir.read(ubo, vkAF::eUniformRead)
+		.write(gBuf.getWorldPosTexture().image)
+		.write(gBuf.getAlbedoTexture().image)
+		.write(gBuf.getNormalTexture().image)
+		.write(gBuf.getMaterialPropertiesTexture().image)
+		.write(m_reservoirTmpInfoBuffer.image)
+		.write(m_reservoirTmpWeightBuffer.image)
+		.read(m_reservoirInfoBuffers[prevFrame].image)
+		.read(m_reservoirWeightBuffers[prevFrame].image)
+		.write(m_giReservoirTmpSampleBuffer.image)
+		.write(m_giReservoirTmpRadianceBuffer.image)
+		.read(m_giReservoirSampleBuffers[prevFrame].image)
+		.read(m_giReservoirRadianceBuffers[prevFrame].image)
+		.readWrite(m_candidateBudgetBuffer.image)
+		.readWrite(m_candidateStatsBuffer.buffer)
+		.readWrite(m_pipelineStatsBuffer.buffer)
+		.write(m_shaderCostImage.image)
+		.read(m_lightCellCountBuffer.buffer)
+		.read(m_lightCellEntryBuffer.buffer)
+		.read(m_presampledLightBuffer.buffer)
+		.readWrite(m_worldGridCellBuffer.buffer)
+		.readWrite(m_worldGridReservoirBuffer.buffer);
+	readGBuffer(restir, prevGBuf);
+
+	auto spatialReuse = m_renderGraph.addPass("spatialReuse", vkPS::eComputeShader, [this, frame](const vk::CommandBuffer& cmdBuf) {
+		m_spatialReusePass.run(cmdBuf, m_sceneSet, m_lightSet, m_restirSets[frame]);
+	});
+	spatialReuse.read(ubo, vkAF::eUniformRead)
+		.read(m_reservoirTmpInfoBuffer.image)
+		.read(m_reservoirTmpWeightBuffer.image)
+		.write(m_reservoirInfoBuffers[frame].image)
+		.write(m_reservoirWeightBuffers[frame].image)
+		.readWrite(m_candidateBudgetBuffer.image)
+		.readWrite(m_candidateStatsBuffer.buffer)
+		.readWrite(m_pipelineStatsBuffer.buffer)
+		.write(m_shaderCostImage.image);
+	readGBuffer(spatialReuse, gBuf);
+
+	// the slot of the frame is read by _readPipelineStats once the frame timeline reached it
+	if (m_enablePipelineStats) {
+		uint32_t slot = uint32_t(m_submittedFrames % numPipelineStatsSlots);
+		m_pipelineStatsSlotFrames[slot] = m_submittedFrames + 1;
+		m_renderGraph.addPass("pipelineStatsCopy", vkPS::eTransfer, [this, slot](const vk::CommandBuffer& cmdBuf) {
+			vk::BufferCopy region{ 0, slot * sizeof(shader::PipelineStats), sizeof(shader::PipelineStats) };
+			cmdBuf.copyBuffer(m_pipelineStatsBuffer.buffer, m_pipelineStatsReadbackBuffer.buffer, region);
+		}, false)
+			.read(m_pipelineStatsBuffer.buffer, vkAF::eTransferRead)
+			.write(m_pipelineStatsReadbackBuffer.buffer, vkAF::eTransferWrite);
+	}
+
+	if (m_enableGI) {
+		auto giSpatialReuse = m_renderGraph.addPass("giSpatialReuse", vkPS::eComputeShader, [this, frame](const vk::CommandBuffer& cmdBuf) {
+			m_giSpatialReusePass.run(cmdBuf, m_sceneSet, m_lightSet, m_restirSets[frame]);
+		});
+		giSpatialReuse.read(ubo, vkAF::eUniformRead)
+			.read(m_giReservoirTmpSampleBuffer.image)
+			.read(m_giReservoirTmpRadianceBuffer.image)
+			.write(m_giReservoirSampleBuffers[frame].image)
+			.write(m_giReservoirRadianceBuffers[frame].image);
+		readGBuffer(giSpatialReuse, gBuf);
+	}
+
+	auto shade = m_renderGraph.addPass("shade", vkPS::eComputeShader, [this, frame](const vk::CommandBuffer& cmdBuf) {
+		m_shadePass.run(cmdBuf, m_sceneSet, m_lightSet, m_restirSets[frame], m_pushC);
+	});
+	shade.read(ubo, vkAF::eUniformRead)
+		.read(m_reservoirInfoBuffers[frame].image)
+		.read(m_reservoirWeightBuffers[frame].image)
+		.read(m_giReservoirSampleBuffers[frame].image)
+		.read(m_giReservoirRadianceBuffers[frame].image)
+		.read(m_candidateBudgetBuffer.image)
+		.read(m_worldGridCellBuffer.buffer)
+		.read(m_worldGridReservoirBuffer.buffer)
+		.read(m_shaderCostImage.image)
+		.readWrite(m_pHatErrorStatsBuffer.buffer)
+		.write(m_radianceImage.image)
+		.readWrite(m_storageImage.image);
+	readGBuffer(shade, gBuf);
+
+	if (m_enableDenoiser) {
+		auto denoise = m_renderGraph.addPass("denoise", vkPS::eComputeShader, [this, frame](const vk::CommandBuffer& cmdBuf) {
+			m_denoisePass.run(cmdBuf, m_sceneSet, m_lightSet, m_restirSets[frame], m_sceneUniforms.denoiseIterations);
+		});
+		denoise.read(ubo, vkAF::eUniformRead)
+			.read(m_radianceImage.image)
+			.read(m_denoiseHistoryColorBuffers[prevFrame].image)
+			.read(m_denoiseHistoryMomentsBuffers[prevFrame].image)
+			.readWrite(m_denoiseHistoryColorBuffers[frame].image)
+			.write(m_denoiseHistoryMomentsBuffers[frame].image)
+			.readWrite(m_denoisePingBuffer.image)
+			.readWrite(m_denoisePongBuffer.image)
+			.write(m_denoiseOutputBuffer.image);
+		readGBuffer(denoise, gBuf);
+		readGBuffer(denoise, prevGBuf);
+	}
+
+	// the tonemapping is recorded in the frame command buffer, submitted after this one
+	m_renderGraph.addPass("post", vkPS::eVertexShader | vkPS::eFragmentShader, nullptr, false)
+		.read(ubo, vkAF::eUniformRead)
+		.read(m_storageImage.image)
+		.read(m_denoiseOutputBuffer.image);
+	// read by the CPU once the frame timeline reaches this frame
+	auto readback = m_renderGraph.addPass("readback", vkPS::eHost, nullptr, false);
+	readback.read(m_candidateStatsBuffer.buffer, vkAF::eHostRead);
+	readback.read(m_pHatErrorStatsBuffer.buffer, vkAF::eHostRead);
+	if (m_enablePipelineStats) {
+		readback.read(m_pipelineStatsReadbackBuffer.buffer, vkAF::eHostRead);
+	}
+
+	m_renderGraph.execute(cmdBuf, &m_gpuTimer);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Destroying all allocations
 //
 void App::destroyResources()
 {
-
 	m_device.destroy(m_sceneSetLayout);
 	m_alloc.destroy(m_sceneUniformBuffer);
 
@@ -243,30 +771,39 @@ void App::destroyResources()
 	m_device.destroy(m_restirSetLayout);
 
 
-	for (auto& t : m_reservoirInfoBuffers) {
-		m_alloc.destroy(t);
-	}
-	for (auto& t : m_reservoirWeightBuffers) {
-		m_alloc.destroy(t);
-	}
-	m_alloc.destroy(m_storageImage);
-	m_alloc.destroy(m_reservoirTmpInfoBuffer);
-	m_alloc.destroy(m_reservoirTmpWeightBuffer);
+	_destroyRenderTargets();
+	m_alloc.unmap(m_candidateStatsBuffer);
+	m_alloc.destroy(m_candidateStatsBuffer);
+	m_alloc.unmap(m_pHatErrorStatsBuffer);
+	m_alloc.destroy(m_pHatErrorStatsBuffer);
+	m_alloc.destroy(m_pipelineStatsBuffer);
+	m_alloc.unmap(m_pipelineStatsReadbackBuffer);
+	m_alloc.destroy(m_pipelineStatsReadbackBuffer);
+	m_alloc.destroy(m_presampledLightBuffer);
+	_destroyWorldGrid();
 	//#Post
 	m_device.destroy(m_postPipeline);
 	m_device.destroy(m_postPipelineLayout);
 
-	m_device.destroy(m_mainFence);
+	m_device.destroy(m_frameTimeline);
 
 	m_sceneBuffers.destroy();
 
 	m_restirPass.destroy();
 	m_spatialReusePass.destroy();
+	m_giSpatialReusePass.destroy();
+	m_shadePass.destroy();
+	m_denoisePass.destroy();
+	m_lightCullingPass.destroy();
+	m_lightPresamplePass.destroy();
+	m_worldGridPass.destroy();
+	m_gpuTimer.destroy();
 
 	for (auto& gBuf : m_gBuffers) {
 		gBuf.destroy();
 	}
 	m_alloc.deinit();
+	m_memAllocator.deinit();
 
 }
 
@@ -339,12 +876,13 @@ void App::_createUniformBuffer()
 
 	m_sceneUniforms.debugMode = 0;
 	m_sceneUniforms.gamma = 2.2;
+	m_renderSize = m_size;
 	m_sceneUniforms.screenSize = nvmath::uvec2(m_size.width, m_size.height);
 	m_sceneUniforms.flags = RESTIR_VISIBILITY_REUSE_FLAG | RESTIR_TEMPORAL_REUSE_FLAG | RESTIR_SPATIAL_REUSE_FLAG;
 	//if (_enableTemporalReuse) {
 	//	m_sceneUniforms.flags |= RESTIR_TEMPORAL_REUSE_FLAG;
 	//}
-	m_sceneUniforms.spatialNeighbors = 4;
+	m_sceneUniforms.spatialNeighbors = 3;
 	m_sceneUniforms.spatialRadius = 30.0f;
 	m_sceneUniforms.initialLightSampleCount = 1 << m_log2InitialLightSamples;
 	m_sceneUniforms.temporalSampleCountMultiplier = m_temporalReuseSampleMultiplier;
@@ -356,76 +894,325 @@ void App::_createUniformBuffer()
 	m_sceneUniforms.environmentalPower = 1.0;
 	m_sceneUniforms.fireflyClampThreshold = 2.0;
 
+	m_sceneUniforms.denoiseIterations = 4;
+	m_sceneUniforms.denoiseTemporalAlpha = 0.2f;
+	m_sceneUniforms.denoisePhiLuminance = 4.0f;
+	m_sceneUniforms.denoisePhiNormal = 128.0f;
+	m_sceneUniforms.denoisePhiPosition = 0.1f;
+
+	m_sceneUniforms.generationMode = GENERATION_MODE_FULL;
+	m_sceneUniforms.frameIndex = 0;
+
+	m_sceneUniforms.candidateScoreMean = 1.0f;
+
+	m_sceneUniforms.lightInfluenceThreshold = 0.01f;
+	// froxels beyond the scene would be wasted, the slices are exponential in depth
+	m_sceneUniforms.lightCullingFar = std::clamp(m_gltfScene.m_dimensions.radius * 4.0f, 1.0f, 1000.0f);
+
+	m_sceneUniforms.worldGridCellSize = std::max(m_gltfScene.m_dimensions.radius / 16.0f, 1e-3f);
+	m_sceneUniforms.worldGridCellCount = 1u << m_log2WorldGridCells;
+	m_sceneUniforms.worldGridReservoirsPerCell = 16;
+
+	m_sceneUniforms.shaderCostPhase = SHADER_COST_PHASES;
+	m_sceneUniforms.shaderCostScale = 100000.0f;
+
 
 
 	m_sceneUniformBuffer = m_alloc.createBuffer(sizeof(shader::SceneUniforms),
 		vkBU::eUniformBuffer | vkBU::eTransferDst, vkMP::eDeviceLocal);
 	m_debug.setObjectName(m_sceneUniformBuffer.buffer, "sceneBuffer");
 
-	m_reservoirInfoBuffers.resize(numGBuffers);
-	m_reservoirWeightBuffers.resize(numGBuffers);
+	nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
+	vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
+	_updateUniformBuffer(cmdBuf);
 
+	m_candidateStatsBuffer = m_alloc.createBuffer(sizeof(shader::CandidateStats),
+		vkBU::eStorageBuffer, vkMP::eHostVisible | vkMP::eHostCoherent);
+	m_debug.setObjectName(m_candidateStatsBuffer.buffer, "candidateStats");
+	m_candidateStats = static_cast<shader::CandidateStats*>(m_alloc.map(m_candidateStatsBuffer));
+	*m_candidateStats = {};
+
+	m_pHatErrorStatsBuffer = m_alloc.createBuffer(sizeof(shader::PHatErrorStats),
+		vkBU::eStorageBuffer, vkMP::eHostVisible | vkMP::eHostCoherent);
+	m_debug.setObjectName(m_pHatErrorStatsBuffer.buffer, "pHatErrorStats");
+	m_pHatErrorStats = static_cast<shader::PHatErrorStats*>(m_alloc.map(m_pHatErrorStatsBuffer));
+	*m_pHatErrorStats = {};
+
+	m_pipelineStatsBuffer = m_alloc.createBuffer(sizeof(shader::PipelineStats),
+		vkBU::eStorageBuffer | vkBU::eTransferDst | vkBU::eTransferSrc, vkMP::eDeviceLocal);
+	m_debug.setObjectName(m_pipelineStatsBuffer.buffer, "pipelineStats");
+	m_pipelineStatsReadbackBuffer = m_alloc.createBuffer(numPipelineStatsSlots * sizeof(shader::PipelineStats),
+		vkBU::eTransferDst, vkMP::eHostVisible | vkMP::eHostCoherent);
+	m_debug.setObjectName(m_pipelineStatsReadbackBuffer.buffer, "pipelineStatsReadback");
+	m_pipelineStatsSlots = static_cast<const shader::PipelineStats*>(m_alloc.map(m_pipelineStatsReadbackBuffer));
+
+	m_presampledLightBuffer = m_alloc.createBuffer(
+		LIGHT_PRESAMPLE_TILE_COUNT * LIGHT_PRESAMPLE_TILE_SIZE * sizeof(shader::PresampledLight),
+		vkBU::eStorageBuffer, vkMP::eDeviceLocal);
+	m_debug.setObjectName(m_presampledLightBuffer.buffer, "presampledLights");
+
+	cmdBufGet.submitAndWait(cmdBuf);
+	m_alloc.finalizeAndReleaseStaging();
+
+}
 
+//--------------------------------------------------------------------------------------------------
+// Images read and written by the passes, allocated at the window size.
+// Frames are rendered in the m_renderSize sub-rectangle of them.
+//
+void App::_createRenderTargets()
+{
 	nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
 	vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
 
+	for (const RenderTarget& target : _renderTargets(m_size)) {
+		if (target.texture != nullptr) {
+			*target.texture = _createStorageImage(cmdBuf, target.imageInfo, target.viewType);
+		}
+		else {
+			*target.buffer = m_alloc.createBuffer(target.bufferSize, target.bufferUsage, vk::MemoryPropertyFlagBits::eDeviceLocal);
+			m_debug.setObjectName(target.buffer->buffer, target.name);
+		}
+	}
 
+	cmdBufGet.submitAndWait(cmdBuf);
+	m_alloc.finalizeAndReleaseStaging();
 
-	_updateUniformBuffer(cmdBuf);
-	auto colorCreateInfo = nvvk::makeImage2DCreateInfo(m_size, vk::Format::eR32G32B32A32Sfloat,
+	_createTransientTargets(_colorTargetInfo(m_size), _reservoirTargetInfo(m_size));
+
+	m_workingSets.clear();
+	for (vk::Extent2D extent : { vk::Extent2D{ 1920, 1080 }, vk::Extent2D{ 3840, 2160 } }) {
+		m_workingSets.push_back(_estimateWorkingSet(extent));
+		const MemoryStats::WorkingSet& workingSet = m_workingSets.back();
+		LOGI("Render targets at %ux%u: %.1f MB, %.1f MB with transient aliasing\n", extent.width, extent.height,
+			workingSet.bytes / (1024.0 * 1024.0), workingSet.aliasedBytes / (1024.0 * 1024.0));
+	}
+}
+
+vk::ImageCreateInfo App::_colorTargetInfo(vk::Extent2D extent) const
+{
+	return nvvk::makeImage2DCreateInfo(extent, vk::Format::eR32G32B32A32Sfloat,
 		vk::ImageUsageFlagBits::eColorAttachment
 		| vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage
+		| vk::ImageUsageFlagBits::eTransferSrc
 	);
-	vk::SamplerCreateInfo samplerCreateInfo{ {}, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest };
+}
+
+vk::ImageCreateInfo App::_reservoirTargetInfo(vk::Extent2D extent) const
+{
+	vk::ImageCreateInfo createInfo = _colorTargetInfo(extent);
+	createInfo.setArrayLayers(m_reservoirSize);
+	return createInfo;
+}
 
+//--------------------------------------------------------------------------------------------------
+// Persistent render targets at a resolution, created by _createRenderTargets and sized by _estimateWorkingSet
+//
+std::vector<App::RenderTarget> App::_renderTargets(vk::Extent2D extent)
+{
+	m_reservoirInfoBuffers.resize(numGBuffers);
+	m_reservoirWeightBuffers.resize(numGBuffers);
+	m_denoiseHistoryColorBuffers.resize(numGBuffers);
+	m_denoiseHistoryMomentsBuffers.resize(numGBuffers);
+	m_giReservoirSampleBuffers.resize(numGBuffers);
+	m_giReservoirRadianceBuffers.resize(numGBuffers);
+
+	vk::ImageCreateInfo color = _colorTargetInfo(extent);
+	vk::ImageCreateInfo reservoir = _reservoirTargetInfo(extent);
+	auto costCreateInfo = nvvk::makeImage2DCreateInfo(extent, vk::Format::eR32Uint,
+		vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst);
+	costCreateInfo.setArrayLayers(SHADER_COST_LAYERS);
+	vk::DeviceSize cellCount = lightCellCount(extent);
+	vk::BufferUsageFlags cellUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+
+	std::vector<RenderTarget> targets;
+	auto image = [&](nvvk::Texture& texture, const vk::ImageCreateInfo& createInfo, vk::ImageViewType viewType = vk::ImageViewType::e2D) {
+		targets.push_back({ &texture, createInfo, viewType, nullptr, 0, {}, nullptr });
+	};
+	auto buffer = [&](nvvk::Buffer& target, vk::DeviceSize size, vk::BufferUsageFlags usage, const char* name) {
+		targets.push_back({ nullptr, {}, vk::ImageViewType::e2D, &target, size, usage, name });
+	};
 	for (std::size_t i = 0; i < numGBuffers; ++i) {
-		{
-			nvvk::Image             image = m_alloc.createImage(colorCreateInfo);
-			vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-			m_reservoirInfoBuffers[i] = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-			m_reservoirInfoBuffers[i].descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			nvvk::cmdBarrierImageLayout(cmdBuf, m_reservoirInfoBuffers[i].image, vk::ImageLayout::eUndefined,
-				vk::ImageLayout::eGeneral);
-		}
-		{
-			nvvk::Image             image = m_alloc.createImage(colorCreateInfo);
-			vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-			m_reservoirWeightBuffers[i] = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-			m_reservoirWeightBuffers[i].descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			nvvk::cmdBarrierImageLayout(cmdBuf, m_reservoirWeightBuffers[i].image, vk::ImageLayout::eUndefined,
-				vk::ImageLayout::eGeneral);
-		}
+		image(m_reservoirInfoBuffers[i], reservoir, vk::ImageViewType::e2DArray);
+		image(m_reservoirWeightBuffers[i], reservoir, vk::ImageViewType::e2DArray);
+		image(m_denoiseHistoryColorBuffers[i], color);
+		image(m_denoiseHistoryMomentsBuffers[i], color);
+		image(m_giReservoirSampleBuffers[i], color);
+		image(m_giReservoirRadianceBuffers[i], color);
 	}
-	{
-		{
-			nvvk::Image             image = m_alloc.createImage(colorCreateInfo);
-			vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-			m_reservoirTmpInfoBuffer = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-			m_reservoirTmpInfoBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			nvvk::cmdBarrierImageLayout(cmdBuf, m_reservoirTmpInfoBuffer.image, vk::ImageLayout::eUndefined,
-				vk::ImageLayout::eGeneral);
-		}
-		{
-			nvvk::Image             image = m_alloc.createImage(colorCreateInfo);
-			vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-			m_reservoirTmpWeightBuffer = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-			m_reservoirTmpWeightBuffer.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-			nvvk::cmdBarrierImageLayout(cmdBuf, m_reservoirTmpWeightBuffer.image, vk::ImageLayout::eUndefined,
-				vk::ImageLayout::eGeneral);
-		}
+	image(m_storageImage, color);
+	image(m_denoiseOutputBuffer, color);
+	image(m_candidateBudgetBuffer, color);
+	// clock cycles per pixel and phase
+	image(m_shaderCostImage, costCreateInfo, vk::ImageViewType::e2DArray);
+	buffer(m_lightCellCountBuffer, cellCount * sizeof(uint32_t), cellUsage, "lightCellCounts");
+	buffer(m_lightCellEntryBuffer, cellCount * LIGHT_CELL_CAPACITY * sizeof(shader::LightCellEntry), cellUsage, "lightCellEntries");
+	return targets;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Scratch targets only used within a frame, with the passes they are used between
+//
+std::vector<App::TransientTarget> App::_transientTargets()
+{
+	return {
+		{ &m_reservoirTmpInfoBuffer, true, ePassRestir, ePassSpatialReuse },
+		{ &m_reservoirTmpWeightBuffer, true, ePassRestir, ePassSpatialReuse },
+		{ &m_giReservoirTmpSampleBuffer, false, ePassRestir, ePassGISpatialReuse },
+		{ &m_giReservoirTmpRadianceBuffer, false, ePassRestir, ePassGISpatialReuse },
+		{ &m_radianceImage, false, ePassShade, ePassDenoise },
+		{ &m_denoisePingBuffer, false, ePassDenoise, ePassDenoise },
+		{ &m_denoisePongBuffer, false, ePassDenoise, ePassDenoise },
+	};
+}
+
+void App::_createTransientTargets(const vk::ImageCreateInfo& colorCreateInfo, const vk::ImageCreateInfo& reservoirCreateInfo)
+{
+	std::vector<TransientTarget> targets = _transientTargets();
+	for (const TransientTarget& target : targets) {
+		const vk::ImageCreateInfo& createInfo = target.reservoir ? reservoirCreateInfo : colorCreateInfo;
+		target.texture->image = m_device.createImage(createInfo);
+		m_transientMemory.add(target.texture->image, target.firstPass, target.lastPass);
+	}
+	// the views need the memory bound
+	m_transientMemory.allocate();
+	for (const TransientTarget& target : targets) {
+		const vk::ImageCreateInfo& createInfo = target.reservoir ? reservoirCreateInfo : colorCreateInfo;
+		vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(target.texture->image, createInfo);
+		ivInfo.setViewType(target.reservoir ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D);
+		target.texture->descriptor.imageView = m_device.createImageView(ivInfo);
+		target.texture->descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		// the content does not survive the frame, the render graph moves them out of the undefined layout at their first use
+		m_renderGraph.setTransient(target.texture->image, m_transientMemory.getAliases(target.texture->image));
 	}
+}
 
-	nvvk::Image             image = m_alloc.createImage(colorCreateInfo);
-	vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
-	m_storageImage = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
-	m_storageImage.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+void App::_destroyTransientTargets()
+{
+	for (const TransientTarget& target : _transientTargets()) {
+		m_device.destroy(vk::ImageView(target.texture->descriptor.imageView));
+		m_device.destroy(vk::Image(target.texture->image));
+		*target.texture = nvvk::Texture();
+	}
+	m_transientMemory.free();
+}
 
-	nvvk::cmdBarrierImageLayout(cmdBuf, m_storageImage.image, vk::ImageLayout::eUndefined,
-		vk::ImageLayout::eGeneral);
+//--------------------------------------------------------------------------------------------------
+// Memory of the render targets at a resolution, before and after aliasing the transient ones
+//
+MemoryStats::WorkingSet App::_estimateWorkingSet(vk::Extent2D extent)
+{
+	auto imageRequirements = [&](const vk::ImageCreateInfo& createInfo) {
+		vk::Image image = m_device.createImage(createInfo);
+		vk::MemoryRequirements result = m_device.getImageMemoryRequirements(image);
+		m_device.destroy(image);
+		return result;
+	};
+	auto bufferRequirements = [&](vk::DeviceSize size, vk::BufferUsageFlags usage) {
+		vk::Buffer buffer = m_device.createBuffer({ {}, size, usage });
+		vk::MemoryRequirements result = m_device.getBufferMemoryRequirements(buffer);
+		m_device.destroy(buffer);
+		return result;
+	};
 
+	// the persistent targets of _createRenderTargets and the G-buffers are alive over the whole frame
+	MemoryStats::WorkingSet workingSet;
+	workingSet.extent = extent;
+	vk::DeviceSize persistent = numGBuffers * GBuffer::imageCount * imageRequirements(GBuffer::imageCreateInfo(extent)).size;
+	for (const RenderTarget& target : _renderTargets(extent)) {
+		persistent += target.texture != nullptr ? imageRequirements(target.imageInfo).size
+			: bufferRequirements(target.bufferSize, target.bufferUsage).size;
+	}
+	vk::MemoryRequirements color = imageRequirements(_colorTargetInfo(extent));
+	vk::MemoryRequirements reservoir = imageRequirements(_reservoirTargetInfo(extent));
+	std::vector<TransientMemory::Block> blocks;
+	for (const TransientTarget& target : _transientTargets()) {
+		const vk::MemoryRequirements& req = target.reservoir ? reservoir : color;
+		TransientMemory::Block block;
+		block.size = req.size;
+		block.alignment = req.alignment;
+		block.firstPass = target.firstPass;
+		block.lastPass = target.lastPass;
+		blocks.push_back(block);
+		workingSet.bytes += req.size;
+	}
+	workingSet.bytes += persistent;
+	workingSet.aliasedBytes = persistent + TransientMemory::place(blocks);
+	return workingSet;
+}
+
+void App::_destroyRenderTargets()
+{
+	// the recreated images start over in the general layout
+	m_renderGraph.reset();
+	for (auto& t : m_reservoirInfoBuffers) {
+		m_alloc.destroy(t);
+	}
+	for (auto& t : m_reservoirWeightBuffers) {
+		m_alloc.destroy(t);
+	}
+	m_alloc.destroy(m_storageImage);
+	_destroyTransientTargets();
+	for (auto& t : m_denoiseHistoryColorBuffers) {
+		m_alloc.destroy(t);
+	}
+	for (auto& t : m_denoiseHistoryMomentsBuffers) {
+		m_alloc.destroy(t);
+	}
+	m_alloc.destroy(m_denoiseOutputBuffer);
+	for (auto& t : m_giReservoirSampleBuffers) {
+		m_alloc.destroy(t);
+	}
+	for (auto& t : m_giReservoirRadianceBuffers) {
+		m_alloc.destroy(t);
+	}
+	m_alloc.destroy(m_candidateBudgetBuffer);
+	m_alloc.destroy(m_shaderCostImage);
+	m_alloc.destroy(m_lightCellCountBuffer);
+	m_alloc.destroy(m_lightCellEntryBuffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Buffers of the world space light reservoir grid, sized from the uniforms and cleared.
+// Writes their bindings of the light set, which must not be in use.
+//
+void App::_createWorldGrid()
+{
+	m_sceneUniforms.worldGridCellCount = 1u << m_log2WorldGridCells;
+	m_sceneUniforms.worldGridReservoirsPerCell = std::max(m_sceneUniforms.worldGridReservoirsPerCell, 1u);
+	m_sceneUniforms.worldGridCellSize = std::max(m_sceneUniforms.worldGridCellSize, 1e-3f);
+
+	vk::DeviceSize cellCount = m_sceneUniforms.worldGridCellCount;
+	m_worldGridCellBuffer = m_alloc.createBuffer(cellCount * sizeof(shader::WorldGridCell),
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_debug.setObjectName(m_worldGridCellBuffer.buffer, "worldGridCells");
+	m_worldGridReservoirBuffer = m_alloc.createBuffer(
+		cellCount * m_sceneUniforms.worldGridReservoirsPerCell * sizeof(shader::WorldGridReservoir),
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	m_debug.setObjectName(m_worldGridReservoirBuffer.buffer, "worldGridReservoirs");
+
+	nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
+	vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
+	cmdBuf.fillBuffer(m_worldGridCellBuffer.buffer, 0, VK_WHOLE_SIZE, WORLD_GRID_EMPTY_KEY);
+	cmdBuf.fillBuffer(m_worldGridReservoirBuffer.buffer, 0, VK_WHOLE_SIZE, WORLD_GRID_EMPTY_KEY);
 	cmdBufGet.submitAndWait(cmdBuf);
-	m_alloc.finalizeAndReleaseStaging();
 
+	vk::DescriptorBufferInfo cellsUnif{ m_worldGridCellBuffer.buffer, 0, VK_WHOLE_SIZE };
+	vk::DescriptorBufferInfo reservoirsUnif{ m_worldGridReservoirBuffer.buffer, 0, VK_WHOLE_SIZE };
+	std::vector<vk::WriteDescriptorSet> writes{
+		m_lightSetLayoutBind.makeWrite(m_lightSet, B_WORLD_GRID_CELLS, &cellsUnif),
+		m_lightSetLayoutBind.makeWrite(m_lightSet, B_WORLD_GRID_RESERVOIRS, &reservoirsUnif)
+	};
+	m_device.updateDescriptorSets(writes, nullptr);
+}
+
+void App::_destroyWorldGrid()
+{
+	// the recreated buffers start without a pending access, the other resources keep their state
+	m_renderGraph.forget(m_worldGridCellBuffer.buffer);
+	m_renderGraph.forget(m_worldGridReservoirBuffer.buffer);
+	m_alloc.destroy(m_worldGridCellBuffer);
+	m_alloc.destroy(m_worldGridReservoirBuffer);
 }
 //--------------------------------------------------------------------------------------------------
 // Describing the layout pushed when rendering
@@ -449,6 +1236,9 @@ void App::_createDescriptorSet()
 	m_lightSetLayoutBind.addBinding(vkDS(B_TRIANGLE_LIGHTS, vkDT::eStorageBuffer, 1, vkSS::eFragment | vkSS::eRaygenKHR | vkSS::eCompute));
 	m_lightSetLayoutBind.addBinding(vkDS(B_ENVIRONMENTAL_MAP, vkDT::eCombinedImageSampler, 1, vkSS::eFragment | vkSS::eRaygenKHR | vkSS::eCompute | vkSS::eMissKHR));
 	m_lightSetLayoutBind.addBinding(vkDS(B_ENVIRONMENTAL_ALIAS_MAP, vkDT::eCombinedImageSampler, 1, vkSS::eFragment | vkSS::eRaygenKHR | vkSS::eCompute));
+	m_lightSetLayoutBind.addBinding(vkDS(B_PRESAMPLED_LIGHTS, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_lightSetLayoutBind.addBinding(vkDS(B_WORLD_GRID_CELLS, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_lightSetLayoutBind.addBinding(vkDS(B_WORLD_GRID_RESERVOIRS, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR | vkSS::eCompute));
 
 	m_lightSetLayout = m_lightSetLayoutBind.createLayout(m_device);
 	m_lightSet = nvvk::allocateDescriptorSet(m_device, m_descStaticPool, m_lightSetLayout);
@@ -458,12 +1248,14 @@ void App::_createDescriptorSet()
 	vk::DescriptorBufferInfo aliasTableUnif{ m_sceneBuffers.getAliasTable().buffer, 0, VK_WHOLE_SIZE };
 	const vk::DescriptorImageInfo& environmentalUnif = m_sceneBuffers.getEnvironmentalTexture().descriptor;
 	const vk::DescriptorImageInfo& environmentalAliasUnif = m_sceneBuffers.getEnvironmentalAliasMap().descriptor;
+	vk::DescriptorBufferInfo presampledLightUnif{ m_presampledLightBuffer.buffer, 0, VK_WHOLE_SIZE };
 
 	writes.emplace_back(m_lightSetLayoutBind.makeWrite(m_lightSet, B_ALIAS_TABLE, &aliasTableUnif));
 	writes.emplace_back(m_lightSetLayoutBind.makeWrite(m_lightSet, B_POINT_LIGHTS, &pointLightUnif));
 	writes.emplace_back(m_lightSetLayoutBind.makeWrite(m_lightSet, B_TRIANGLE_LIGHTS, &trialgleLightUnif));
 	writes.emplace_back(m_lightSetLayoutBind.makeWrite(m_lightSet, B_ENVIRONMENTAL_MAP, &environmentalUnif));
 	writes.emplace_back(m_lightSetLayoutBind.makeWrite(m_lightSet, B_ENVIRONMENTAL_ALIAS_MAP, &environmentalAliasUnif));
+	writes.emplace_back(m_lightSetLayoutBind.makeWrite(m_lightSet, B_PRESAMPLED_LIGHTS, &presampledLightUnif));
 
 	m_restirSetLayoutBind.addBinding(vkDS(B_FRAME_WORLD_POSITION, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eFragment | vkSS::eCompute));
 	m_restirSetLayoutBind.addBinding(vkDS(B_FRAME_ALBEDO, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eFragment | vkSS::eCompute));
@@ -481,6 +1273,27 @@ void App::_createDescriptorSet()
 	m_restirSetLayoutBind.addBinding(vkDS(B_TMP_RESERVIORS_INFO, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eFragment | vkSS::eCompute));
 	m_restirSetLayoutBind.addBinding(vkDS(B_TMP_RESERVIORS_WEIGHT, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eFragment | vkSS::eCompute));
 	m_restirSetLayoutBind.addBinding(vkDS(B_STORAGE_IMAGE, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eFragment | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_DENOISE_HISTORY_COLOR, vkDT::eStorageImage, 1, vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_DENOISE_HISTORY_MOMENTS, vkDT::eStorageImage, 1, vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_PREV_DENOISE_HISTORY_COLOR, vkDT::eStorageImage, 1, vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_PREV_DENOISE_HISTORY_MOMENTS, vkDT::eStorageImage, 1, vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_DENOISE_PING, vkDT::eStorageImage, 1, vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_DENOISE_PONG, vkDT::eStorageImage, 1, vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_DENOISE_OUTPUT, vkDT::eStorageImage, 1, vkSS::eFragment | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_RADIANCE, vkDT::eStorageImage, 1, vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_CANDIDATE_BUDGET, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_CANDIDATE_STATS, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_LIGHT_CELL_COUNTS, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_LIGHT_CELL_ENTRIES, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_GI_RESERVOIRS_SAMPLE, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_GI_RESERVOIRS_RADIANCE, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_PREV_GI_RESERVOIRS_SAMPLE, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_PREV_GI_RESERVOIRS_RADIANCE, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_TMP_GI_RESERVOIRS_SAMPLE, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_TMP_GI_RESERVOIRS_RADIANCE, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_PIPELINE_STATS, vkDT::eStorageBuffer, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_SHADER_COST, vkDT::eStorageImage, 1, vkSS::eRaygenKHR | vkSS::eCompute));
+	m_restirSetLayoutBind.addBinding(vkDS(B_PHAT_ERROR_STATS, vkDT::eStorageBuffer, 1, vkSS::eCompute));
 	m_restirSetLayout = m_restirSetLayoutBind.createLayout(m_device);
 	m_restirSets.resize(numGBuffers);
 	nvvk::allocateDescriptorSets(m_device, m_descStaticPool, m_restirSetLayout, numGBuffers, m_restirSets);
@@ -495,16 +1308,11 @@ void App::_createDescriptorSet()
 //
 void App::_createPostPipeline()
 {
-	// Push constants in the fragment shader
-	vk::PushConstantRange pushConstantRanges = { vk::ShaderStageFlagBits::eFragment, 0, sizeof(shader::PushConstant) };
-
 	// Creating the pipeline layout
 	std::vector<vk::DescriptorSetLayout> layouts = { m_sceneSetLayout, m_lightSetLayout ,m_restirSetLayout };
 	vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo;
 	//pipelineLayoutCreateInfo.setSetLayoutCount(1);
 	pipelineLayoutCreateInfo.setSetLayouts(layouts);
-	pipelineLayoutCreateInfo.setPushConstantRangeCount(1);
-	pipelineLayoutCreateInfo.setPPushConstantRanges(&pushConstantRanges);
 	m_postPipelineLayout = m_device.createPipelineLayout(pipelineLayoutCreateInfo);
 
 	// Pipeline: completely generic, no vertices
@@ -512,9 +1320,9 @@ void App::_createPostPipeline()
 
 	nvvk::GraphicsPipelineGeneratorCombined pipelineGenerator(m_device, m_postPipelineLayout,
 		m_renderPass);
-	pipelineGenerator.addShader(nvh::loadFile("src/shaders/quad.vert.spv", true, paths, true),
+	pipelineGenerator.addShader(nvh::loadFile(shaderSpv("src/shaders/quad.vert"), true, paths, true),
 		vk::ShaderStageFlagBits::eVertex);
-	pipelineGenerator.addShader(nvh::loadFile("src/shaders/post.frag.spv", true, paths, true),
+	pipelineGenerator.addShader(nvh::loadFile(shaderSpv("src/shaders/post.frag"), true, paths, true),
 		vk::ShaderStageFlagBits::eFragment);
 	pipelineGenerator.rasterizationState.setCullMode(vk::CullModeFlagBits::eNone);
 	m_postPipeline = pipelineGenerator.createPipeline();
@@ -524,15 +1332,31 @@ void App::_createPostPipeline()
 void App::_createMainCommandBuffer() {
 	m_mainCommandBuffer =
 		m_device.allocateCommandBuffers({ m_cmdPool, vk::CommandBufferLevel::ePrimary, 1 })[0];
-	vk::FenceCreateInfo fenceInfo;
-	fenceInfo
-		.setFlags(vk::FenceCreateFlagBits::eSignaled);
-	m_mainFence = m_device.createFence(fenceInfo);
+	vk::SemaphoreTypeCreateInfo timelineInfo{ vk::SemaphoreType::eTimeline, 0 };
+	m_frameTimeline = m_device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&timelineInfo));
+}
+
+nvvk::Texture App::_createStorageImage(const vk::CommandBuffer& cmdBuf, const vk::ImageCreateInfo& createInfo,
+	vk::ImageViewType viewType) {
+	vk::SamplerCreateInfo samplerCreateInfo{ {}, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest };
+	nvvk::Image             image = m_alloc.createImage(createInfo);
+	vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, createInfo);
+	ivInfo.setViewType(viewType);
+	nvvk::Texture texture = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
+	texture.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	nvvk::cmdBarrierImageLayout(cmdBuf, texture.image, vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eGeneral);
+	return texture;
 }
 
 void App::_updateRestirDescriptorSet()
 {
 	std::vector<vk::WriteDescriptorSet> writes;
+	vk::DescriptorBufferInfo candidateStatsUnif{ m_candidateStatsBuffer.buffer, 0, VK_WHOLE_SIZE };
+	vk::DescriptorBufferInfo lightCellCountsUnif{ m_lightCellCountBuffer.buffer, 0, VK_WHOLE_SIZE };
+	vk::DescriptorBufferInfo lightCellEntriesUnif{ m_lightCellEntryBuffer.buffer, 0, VK_WHOLE_SIZE };
+	vk::DescriptorBufferInfo pipelineStatsUnif{ m_pipelineStatsBuffer.buffer, 0, VK_WHOLE_SIZE };
+	vk::DescriptorBufferInfo pHatErrorStatsUnif{ m_pHatErrorStatsBuffer.buffer, 0, VK_WHOLE_SIZE };
 
 	for (uint32_t i = 0; i < numGBuffers; i++) {
 		vk::DescriptorSet& set = m_restirSets[i];
@@ -557,6 +1381,28 @@ void App::_updateRestirDescriptorSet()
 		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_TMP_RESERVIORS_INFO, &m_reservoirTmpInfoBuffer.descriptor));
 		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_TMP_RESERVIORS_WEIGHT, &m_reservoirTmpWeightBuffer.descriptor));
 
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_DENOISE_HISTORY_COLOR, &m_denoiseHistoryColorBuffers[i].descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_DENOISE_HISTORY_MOMENTS, &m_denoiseHistoryMomentsBuffers[i].descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_PREV_DENOISE_HISTORY_COLOR, &m_denoiseHistoryColorBuffers[(numGBuffers + i - 1) % numGBuffers].descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_PREV_DENOISE_HISTORY_MOMENTS, &m_denoiseHistoryMomentsBuffers[(numGBuffers + i - 1) % numGBuffers].descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_DENOISE_PING, &m_denoisePingBuffer.descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_DENOISE_PONG, &m_denoisePongBuffer.descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_DENOISE_OUTPUT, &m_denoiseOutputBuffer.descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_RADIANCE, &m_radianceImage.descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_CANDIDATE_BUDGET, &m_candidateBudgetBuffer.descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_CANDIDATE_STATS, &candidateStatsUnif));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_LIGHT_CELL_COUNTS, &lightCellCountsUnif));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_LIGHT_CELL_ENTRIES, &lightCellEntriesUnif));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_GI_RESERVOIRS_SAMPLE, &m_giReservoirSampleBuffers[i].descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_GI_RESERVOIRS_RADIANCE, &m_giReservoirRadianceBuffers[i].descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_PREV_GI_RESERVOIRS_SAMPLE, &m_giReservoirSampleBuffers[(numGBuffers + i - 1) % numGBuffers].descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_PREV_GI_RESERVOIRS_RADIANCE, &m_giReservoirRadianceBuffers[(numGBuffers + i - 1) % numGBuffers].descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_TMP_GI_RESERVOIRS_SAMPLE, &m_giReservoirTmpSampleBuffer.descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_TMP_GI_RESERVOIRS_RADIANCE, &m_giReservoirTmpRadianceBuffer.descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_PIPELINE_STATS, &pipelineStatsUnif));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_SHADER_COST, &m_shaderCostImage.descriptor));
+		writes.emplace_back(m_restirSetLayoutBind.makeWrite(set, B_PHAT_ERROR_STATS, &pHatErrorStatsUnif));
+
 
 	}
 	m_device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
@@ -580,6 +1426,10 @@ void App::_updateUniformBuffer(const vk::CommandBuffer& cmdBuf)
 	m_sceneUniforms.prevCamPos = m_sceneUniforms.cameraPos;
 	m_sceneUniforms.cameraPos = CameraManip.getCamera().eye;
 	m_sceneUniforms.initialLightSampleCount = 1 << m_log2InitialLightSamples;
+	m_sceneUniforms.frameIndex++;
+	m_sceneUniforms.prevScreenSize = m_sceneUniforms.screenSize;
+	m_sceneUniforms.screenSize = nvmath::uvec2(m_renderSize.width, m_renderSize.height);
+	m_sceneUniforms.displaySize = nvmath::uvec2(m_size.width, m_size.height);
 
 	if (m_enableTemporalReuse) {
 		m_sceneUniforms.flags |= RESTIR_TEMPORAL_REUSE_FLAG;
@@ -605,38 +1455,303 @@ void App::_updateUniformBuffer(const vk::CommandBuffer& cmdBuf)
 	else {
 		m_sceneUniforms.flags &= ~USE_ENVIRONMENT_FLAG;
 	}
-	// UBO on the device, and what stages access it.
-	vk::Buffer deviceUBO = m_sceneUniformBuffer.buffer;
-	auto uboUsageStages = vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader
-		| vk::PipelineStageFlagBits::eRayTracingShaderKHR;
-
-	// Ensure that the modified UBO is not visible to previous frames.
-	vk::BufferMemoryBarrier beforeBarrier;
-	beforeBarrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
-	beforeBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
-	beforeBarrier.setBuffer(deviceUBO);
-	beforeBarrier.setOffset(0);
-	beforeBarrier.setSize(sizeof m_sceneUniforms);
-	cmdBuf.pipelineBarrier(
-		uboUsageStages,
-		vk::PipelineStageFlagBits::eTransfer,
-		vk::DependencyFlagBits::eDeviceGroup, {}, { beforeBarrier }, {});
-
+	if (m_enableDenoiser) {
+		m_sceneUniforms.flags |= DENOISER_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~DENOISER_FLAG;
+	}
+	if (m_enableAdaptiveCandidates) {
+		m_sceneUniforms.flags |= ADAPTIVE_CANDIDATES_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~ADAPTIVE_CANDIDATES_FLAG;
+	}
+	if (m_enableLightCulling) {
+		m_sceneUniforms.flags |= LIGHT_CULLING_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~LIGHT_CULLING_FLAG;
+	}
+	if (m_enableLightPresampling) {
+		m_sceneUniforms.flags |= LIGHT_PRESAMPLING_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~LIGHT_PRESAMPLING_FLAG;
+	}
+	if (m_enableWorldGrid) {
+		m_sceneUniforms.flags |= WORLD_GRID_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~WORLD_GRID_FLAG;
+	}
+	if (m_enableGI) {
+		m_sceneUniforms.flags |= GI_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~GI_FLAG;
+	}
+	if (m_enableSubgroupSpatialReuse) {
+		m_sceneUniforms.flags |= SUBGROUP_SPATIAL_REUSE_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~SUBGROUP_SPATIAL_REUSE_FLAG;
+	}
+	if (m_enablePipelineStats) {
+		m_sceneUniforms.flags |= PIPELINE_STATS_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~PIPELINE_STATS_FLAG;
+	}
+	if (m_sceneUniforms.debugMode == DEBUG_SHADER_COST) {
+		m_sceneUniforms.flags |= SHADER_COST_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~SHADER_COST_FLAG;
+	}
+	if (m_measurePHatError || m_sceneUniforms.debugMode == DEBUG_PHAT_HALF_ERROR) {
+		m_sceneUniforms.flags |= PHAT_ERROR_FLAG;
+	}
+	else {
+		m_sceneUniforms.flags &= ~PHAT_ERROR_FLAG;
+	}
 	// Schedule the host-to-device upload. (hostUBO is copied into the cmd
 	// buffer so it is okay to deallocate when the function returns).
+	// The barriers around the upload are placed by the render graph.
 	cmdBuf.updateBuffer<shader::SceneUniforms>(m_sceneUniformBuffer.buffer, 0, m_sceneUniforms);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Device memory of the render targets and G-buffers
+//
+MemoryStats App::_collectMemoryStats() const
+{
+	MemoryStats stats;
+	stats.geometry = m_sceneBuffers.getGeometryBytes();
+	stats.textures = m_sceneBuffers.getTextureBytes();
+	stats.accelerationStructures = m_sceneBuffers.getAsStats().steadyBytes;
+
+	std::vector<vk::Image> gBufferImages;
+	std::vector<vk::Image> reservoirImages;
+	std::vector<vk::Image> renderTargetImages{
+		m_storageImage.image, m_candidateBudgetBuffer.image, m_denoiseOutputBuffer.image, m_shaderCostImage.image
+	};
+	for (std::size_t i = 0; i < numGBuffers; ++i) {
+		gBufferImages.push_back(m_gBuffers[i].getWorldPosTexture().image);
+		gBufferImages.push_back(m_gBuffers[i].getAlbedoTexture().image);
+		gBufferImages.push_back(m_gBuffers[i].getNormalTexture().image);
+		gBufferImages.push_back(m_gBuffers[i].getMaterialPropertiesTexture().image);
+		reservoirImages.push_back(m_reservoirInfoBuffers[i].image);
+		reservoirImages.push_back(m_reservoirWeightBuffers[i].image);
+		reservoirImages.push_back(m_giReservoirSampleBuffers[i].image);
+		reservoirImages.push_back(m_giReservoirRadianceBuffers[i].image);
+		renderTargetImages.push_back(m_denoiseHistoryColorBuffers[i].image);
+		renderTargetImages.push_back(m_denoiseHistoryMomentsBuffers[i].image);
+	}
+	stats.gBuffer = getImageBytes(m_device, gBufferImages);
+	stats.reservoirs = getImageBytes(m_device, reservoirImages);
+	stats.renderTargets = getImageBytes(m_device, renderTargetImages)
+		+ getBufferBytes(m_device, { m_lightCellCountBuffer.buffer, m_lightCellEntryBuffer.buffer, m_presampledLightBuffer.buffer,
+			m_worldGridCellBuffer.buffer, m_worldGridReservoirBuffer.buffer });
+	stats.transient = m_transientMemory.getAllocatedBytes();
+	stats.transientUnaliased = m_transientMemory.getRequiredBytes();
+	stats.workingSets = m_workingSets;
+
+	m_memAllocator.getUtilization(stats.allocatedBlockBytes, stats.usedBlockBytes);
+	queryMemoryHeaps(m_physicalDevice, stats);
+	return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reads back a full screen rgba32f storage image and writes it as PFM.
+// Must be called once the queue is idle.
+//
+bool App::_captureImage(const nvvk::Texture& texture, const std::string& filename)
+{
+	vk::DeviceSize size = vk::DeviceSize(m_renderSize.width) * m_renderSize.height * 4 * sizeof(float);
+	nvvk::Buffer staging = m_alloc.createBuffer(size, vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+	nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
+	vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
+	vk::MemoryBarrier barrier{ vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead };
+	cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+		{}, { barrier }, {}, {});
+	vk::BufferImageCopy region;
+	region.setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, 1 });
+	region.setImageExtent({ m_renderSize.width, m_renderSize.height, 1 });
+	cmdBuf.copyImageToBuffer(texture.image, vk::ImageLayout::eGeneral, staging.buffer, { region });
+	cmdBufGet.submitAndWait(cmdBuf);
+
+	const float* pixels = static_cast<const float*>(m_alloc.map(staging));
+	bool written = writePfm(filename, m_renderSize.width, m_renderSize.height, 4, pixels);
+	m_alloc.unmap(staging);
+	m_alloc.destroy(staging);
+	return written;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reads back the cost image of the last frame and writes where its cycles went: a histogram of the
+// cycles per pixel in power-of-two bins, the cycles per phase of each material (-1 where no surface
+// was hit) sorted by total, and the total cycles of each screen tile. Must be called once the queue is idle.
+//
+bool App::_exportShaderCost(const std::string& filename)
+{
+	const uint32_t width = m_renderSize.width;
+	const uint32_t height = m_renderSize.height;
+	const vk::DeviceSize layerPixels = vk::DeviceSize(width) * height;
+	nvvk::Buffer staging = m_alloc.createBuffer(layerPixels * SHADER_COST_LAYERS * sizeof(uint32_t), vk::BufferUsageFlagBits::eTransferDst,
+		vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+	nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
+	vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
+	vk::MemoryBarrier barrier{ vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead };
+	cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer,
+		{}, { barrier }, {}, {});
+	vk::BufferImageCopy region;
+	region.setImageSubresource({ vk::ImageAspectFlagBits::eColor, 0, 0, SHADER_COST_LAYERS });
+	region.setImageExtent({ width, height, 1 });
+	cmdBuf.copyImageToBuffer(m_shaderCostImage.image, vk::ImageLayout::eGeneral, staging.buffer, { region });
+	cmdBufGet.submitAndWait(cmdBuf);
+
+	constexpr uint32_t tileSize = 32;
+	constexpr int histogramBins = 33;
+	struct MaterialCost {
+		int64_t material;
+		uint64_t pixels{ 0 };
+		uint64_t cycles[SHADER_COST_PHASES]{};
+		uint64_t total{ 0 };
+	};
+	const uint32_t tilesX = (width + tileSize - 1) / tileSize;
+	const uint32_t tilesY = (height + tileSize - 1) / tileSize;
+	std::vector<uint64_t> tileCycles(std::size_t(tilesX) * tilesY, 0);
+	uint64_t histogramPixels[histogramBins]{};
+	uint64_t histogramCycles[histogramBins]{};
+	std::map<int64_t, MaterialCost> materials;
+
+	const uint32_t* cost = static_cast<const uint32_t*>(m_alloc.map(staging));
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			vk::DeviceSize pixel = vk::DeviceSize(y) * width + x;
+			int64_t material = int64_t(cost[SHADER_COST_MATERIAL * layerPixels + pixel]) - 1;
+			MaterialCost& materialCost = materials.emplace(material, MaterialCost{ material }).first->second;
+			uint64_t total = 0;
+			for (int phase = 0; phase < SHADER_COST_PHASES; ++phase) {
+				uint32_t cycles = cost[phase * layerPixels + pixel];
+				materialCost.cycles[phase] += cycles;
+				total += cycles;
+			}
+			// bin 0 holds the pixels without cost, bin i the ones in [2^(i-1), 2^i) cycles
+			int bin = 0;
+			while (bin + 1 < histogramBins && (total >> bin) != 0) {
+				++bin;
+			}
+			histogramPixels[bin] += 1;
+			histogramCycles[bin] += total;
+			materialCost.pixels += 1;
+			materialCost.total += total;
+			tileCycles[std::size_t(y / tileSize) * tilesX + x / tileSize] += total;
+		}
+	}
+	m_alloc.unmap(staging);
+	m_alloc.destroy(staging);
+
+	std::vector<MaterialCost> byMaterial;
+	for (const auto& entry : materials) {
+		byMaterial.push_back(entry.second);
+	}
+	std::sort(byMaterial.begin(), byMaterial.end(), [](const MaterialCost& a, const MaterialCost& b) { return a.total > b.total; });
+
+	std::ofstream out(filename);
+	if (!out) {
+		LOGW("Cannot write %s\n", filename.c_str());
+		return false;
+	}
+	out << "{\n";
+	out << "\t\"resolution\": [" << width << ", " << height << "],\n";
+	out << "\t\"phases\": [\"primaryRay\", \"candidates\", \"visibility\", \"temporal\", \"spatial\"],\n";
+	out << "\t\"histogram\": [";
+	for (int bin = 0; bin < histogramBins; ++bin) {
+		uint64_t minCycles = bin == 0 ? 0 : uint64_t(1) << (bin - 1);
+		out << (bin == 0 ? "\n" : ",\n") << "\t\t{ \"minCycles\": " << minCycles << ", \"pixels\": " << histogramPixels[bin]
+			<< ", \"cycles\": " << histogramCycles[bin] << " }";
+	}
+	out << "\n\t],\n";
+	out << "\t\"materials\": [";
+	for (std::size_t i = 0; i < byMaterial.size(); ++i) {
+		const MaterialCost& materialCost = byMaterial[i];
+		out << (i == 0 ? "\n" : ",\n") << "\t\t{ \"material\": " << materialCost.material << ", \"pixels\": " << materialCost.pixels
+			<< ", \"cycles\": " << materialCost.total << ", \"phaseCycles\": [";
+		for (int phase = 0; phase < SHADER_COST_PHASES; ++phase) {
+			out << (phase ? ", " : "") << materialCost.cycles[phase];
+		}
+		out << "] }";
+	}
+	out << "\n\t],\n";
+	out << "\t\"tiles\": { \"size\": " << tileSize << ", \"columns\": " << tilesX << ", \"rows\": " << tilesY << ", \"cycles\": [";
+	for (std::size_t i = 0; i < tileCycles.size(); ++i) {
+		out << (i ? ", " : "") << tileCycles[i];
+	}
+	out << "] }\n";
+	out << "}\n";
+	LOGI("Shader cost written to %s\n", filename.c_str());
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Collects the adaptive candidate counters of the last frame and resets them.
+// Must be called once the queue is idle.
+//
+void App::_readCandidateStats()
+{
+	const shader::CandidateStats& stats = *m_candidateStats;
+	auto sum = [](uint32_t low, uint32_t high) { return double((uint64_t(high) << 32) | low); };
+	m_averageCandidates = stats.pixelCount > 0 ? float(sum(stats.candidateSumLow, stats.candidateSumHigh) / stats.pixelCount) : 0.0f;
+	if (stats.scoredPixelCount > 0) {
+		m_sceneUniforms.candidateScoreMean = float(sum(stats.scoreSumLow, stats.scoreSumHigh)
+			/ (ADAPTIVE_CANDIDATE_SCORE_SCALE * double(stats.scoredPixelCount)));
+	}
+	*m_candidateStats = {};
+}
 
-	// Making sure the updated UBO will be visible.
-	vk::BufferMemoryBarrier afterBarrier;
-	afterBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
-	afterBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-	afterBarrier.setBuffer(deviceUBO);
-	afterBarrier.setOffset(0);
-	afterBarrier.setSize(sizeof m_sceneUniforms);
-	cmdBuf.pipelineBarrier(
-		vk::PipelineStageFlagBits::eTransfer,
-		uboUsageStages,
-		vk::DependencyFlagBits::eDeviceGroup, {}, { afterBarrier }, {});
+//--------------------------------------------------------------------------------------------------
+// Collects the fp16 target function error of the last frame and resets the counters.
+// Must be called once the queue is idle.
+//
+void App::_readPHatErrorStats()
+{
+	const shader::PHatErrorStats& stats = *m_pHatErrorStats;
+	if (stats.sampleCount > 0) {
+		double sum = double((uint64_t(stats.errorSumHigh) << 32) | stats.errorSumLow);
+		m_pHatErrorMean = float(sum / (PHAT_ERROR_SCALE * double(stats.sampleCount)));
+		uint32_t maxBits = stats.maxError;
+		std::memcpy(&m_pHatErrorMax, &maxBits, sizeof(float));
+		m_pHatErrorSamples = stats.sampleCount;
+		m_pHatErrorZeroed = stats.zeroedCount;
+	}
+	*m_pHatErrorStats = {};
+}
+
+//--------------------------------------------------------------------------------------------------
+// Takes the pipeline statistics of the most recent frame the GPU completed, without waiting.
+// The slots of the frames still in flight are read by a later call.
+//
+void App::_readPipelineStats()
+{
+	uint64_t completed = m_device.getSemaphoreCounterValue(m_frameTimeline);
+	uint64_t latest = m_pipelineStatsFrame;
+	uint32_t latestSlot = 0;
+	for (uint32_t slot = 0; slot < numPipelineStatsSlots; ++slot) {
+		uint64_t frame = m_pipelineStatsSlotFrames[slot];
+		if (frame > latest && frame <= completed) {
+			latest = frame;
+			latestSlot = slot;
+		}
+	}
+	if (latest != m_pipelineStatsFrame) {
+		m_pipelineStats = m_pipelineStatsSlots[latestSlot];
+		m_pipelineStatsFrame = latest;
+	}
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -660,14 +1775,50 @@ void App::_drawPost(vk::CommandBuffer cmdBuf, uint32_t currentGFrame)
 	m_debug.endLabel(cmdBuf);
 }
 
+// The frame command buffer submitted next on the same queue waits for this one through the barrier of
+// the render graph post pass, the CPU does not wait in between
 void App::_submitMainCommand() {
-	while (m_device.waitForFences(m_mainFence, VK_TRUE, 10000) == vk::Result::eTimeout) {
-	}
-	m_device.resetFences(m_mainFence);
+	++m_submittedFrames;
+	vk::TimelineSemaphoreSubmitInfo timelineInfo;
+	timelineInfo.setSignalSemaphoreValues(m_submittedFrames);
 	vk::SubmitInfo submitInfo;
 	submitInfo
-		.setCommandBuffers(m_mainCommandBuffer);
-	m_queue.submit(submitInfo, m_mainFence);
+		.setPNext(&timelineInfo)
+		.setCommandBuffers(m_mainCommandBuffer)
+		.setSignalSemaphores(m_frameTimeline);
+	m_queue.submit(submitInfo);
+	m_frameSubmitTime = std::chrono::steady_clock::now();
+}
+
+void App::_waitForFrame(uint64_t frame) {
+	if (frame == 0) {
+		return;
+	}
+	auto start = std::chrono::steady_clock::now();
+	vk::SemaphoreWaitInfo waitInfo;
+	waitInfo
+		.setSemaphores(m_frameTimeline)
+		.setValues(frame);
+	if (m_device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess) {
+		LOGW("Waiting for frame %llu failed\n", static_cast<unsigned long long>(frame));
+	}
+	auto end = std::chrono::steady_clock::now();
+	m_frameWaitMs = std::chrono::duration<double, std::milli>(end - start).count();
+	if (frame == m_submittedFrames) {
+		m_frameLatencyMs = std::chrono::duration<double, std::milli>(end - m_frameSubmitTime).count();
+	}
+}
+
+// The timestamps of the post pass are written by the frame command buffer, which is submitted after the main
+// one and not covered by the timeline. Reading them blocks, so that time counts as waiting for the frame.
+void App::_resolveGpuTimer() {
+	auto start = std::chrono::steady_clock::now();
+	m_gpuTimer.resolve();
+	auto end = std::chrono::steady_clock::now();
+	m_frameWaitMs += std::chrono::duration<double, std::milli>(end - start).count();
+	if (m_submittedFrames > 0) {
+		m_frameLatencyMs = std::chrono::duration<double, std::milli>(end - m_frameSubmitTime).count();
+	}
 }
 
 
@@ -680,11 +1831,43 @@ void App::_submitMainCommand() {
 
 
 
-void App::onResize(int /*w*/, int /*h*/)
+void App::onResize(int w, int h)
 {
-	/*createOffscreenRender();
-	updatePostDescriptorSet();
-	updateRtDescriptorSet();*/
+	if (w == 0 || h == 0) {
+		return;
+	}
+	// the render targets follow the window, the render size is a fraction of it
+	m_device.waitIdle();
+	_destroyRenderTargets();
+	_createRenderTargets();
+	for (auto& gBuf : m_gBuffers) {
+		gBuf.resize(&m_alloc, m_device, m_graphicsQueueIndex, m_size, m_renderPass);
+	}
+	_updateRestirDescriptorSet();
+	_updateRenderSize(true);
+	_resetFrame();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Picks the size rendered this frame, from the GPU time of the last frame when the resolution is dynamic
+//
+void App::_updateRenderSize(bool force)
+{
+	if (m_enableDynamicResolution) {
+		m_renderScale = m_resolutionController.update(m_gpuTimer.getTotal());
+	}
+	vk::Extent2D renderSize{
+		std::clamp(static_cast<uint32_t>(std::lround(m_size.width * m_renderScale)), 1u, m_size.width),
+		std::clamp(static_cast<uint32_t>(std::lround(m_size.height * m_renderScale)), 1u, m_size.height) };
+	if (!force && renderSize == m_renderSize) {
+		return;
+	}
+	m_renderSize = renderSize;
+	m_restirPass.setRenderSize(m_renderSize);
+	m_spatialReusePass.setRenderSize(m_renderSize);
+	m_giSpatialReusePass.setRenderSize(m_renderSize);
+	m_shadePass.setRenderSize(m_renderSize);
+	m_denoisePass.setRenderSize(m_renderSize);
 	_resetFrame();
 }
 
@@ -713,6 +1896,173 @@ void App::_updateFrame()
 	m_pushC.frame++;
 }
 
+//--------------------------------------------------------------------------------------------------
+// Records the camera at a fixed interval, or plays the loaded path back with a fixed timestep per frame
+// so the same views are rendered regardless of the frame rate.
+//
+void App::_updateCameraPath()
+{
+	if (m_playingPath) {
+		float time = m_pathFrame * m_pathTimestep;
+		m_cameraPath.apply(time);
+		++m_pathFrame;
+		if (time >= m_cameraPath.getDuration()) {
+			if (m_loopPath) {
+				m_pathFrame = 0;
+			}
+			else {
+				m_playingPath = false;
+			}
+		}
+	}
+	else if (m_recordingPath) {
+		float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - m_pathRecordStart).count();
+		if (m_cameraPath.empty() || elapsed - m_cameraPath.getDuration() >= m_pathRecordInterval) {
+			m_cameraPath.record(elapsed);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Recompiles the changed shaders and rebuilds only the pipelines using them.
+// The scene and all the render targets stay as they are.
+//
+void App::_reloadShaders(bool force)
+{
+	if (!m_enableShaderReload && !force) {
+		return;
+	}
+	std::vector<std::string> reloaded = m_shaderReloader.poll(force);
+	if (reloaded.empty()) {
+		return;
+	}
+	_rebuildPipelines(reloaded);
+	_resetFrame();
+}
+
+void App::_rebuildPipelines(const std::vector<std::string>& reloaded)
+{
+	// the frame timeline only covers the main command buffer, the frame command buffer of the previous
+	// frame may still use the post pipeline
+	m_device.waitIdle();
+	auto isReloaded = [&](std::initializer_list<const char*> shaders) {
+		for (const char* shader : shaders) {
+			if (std::find(reloaded.begin(), reloaded.end(), std::string("src/shaders/") + shader) != reloaded.end()) {
+				return true;
+			}
+		}
+		return false;
+	};
+
+	if (isReloaded({ "restir.rgen", "restir.rmiss", "restirShadow.rmiss", "restir.rchit" })) {
+		m_restirPass.destroyPipeline();
+		m_restirPass.createPipeline(m_sceneSetLayout, m_sceneBuffers.getDescLayout(), m_lightSetLayout, m_restirSetLayout);
+	}
+	if (isReloaded({ "spatialReuse.comp" })) {
+		m_spatialReusePass.destroyPipeline();
+		m_spatialReusePass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+	}
+	if (isReloaded({ "giSpatialReuse.comp" })) {
+		m_giSpatialReusePass.destroyPipeline();
+		m_giSpatialReusePass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+	}
+	if (isReloaded({ "shade.comp" })) {
+		m_shadePass.destroyPipeline();
+		m_shadePass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+	}
+	if (isReloaded({ "denoiseTemporal.comp", "denoiseAtrous.comp" })) {
+		m_denoisePass.destroyPipeline();
+		m_denoisePass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+	}
+	if (isReloaded({ "lightCullingBin.comp", "lightCullingBuild.comp" })) {
+		m_lightCullingPass.destroyPipeline();
+		m_lightCullingPass.createPipeline(m_sceneSetLayout, m_lightSetLayout, m_restirSetLayout);
+	}
+	if (isReloaded({ "worldGrid.comp" })) {
+		m_worldGridPass.destroyPipeline();
+		m_worldGridPass.createPipeline(m_sceneSetLayout, m_lightSetLayout);
+	}
+	if (isReloaded({ "lightPresample.comp" })) {
+		m_lightPresamplePass.destroyPipeline();
+		m_lightPresamplePass.createPipeline(m_sceneSetLayout, m_lightSetLayout);
+	}
+	if (isReloaded({ "quad.vert", "post.frag" })) {
+		m_device.destroy(m_postPipeline);
+		m_device.destroy(m_postPipelineLayout);
+		_createPostPipeline();
+	}
+}
+
+//--------------------------------------------------------------------------------------------------
+// Switches every shader to the variant with another value of a define of restirStructs.glsl, compiling
+// its .spv when they are missing or outdated. On failure the previous variant, which the pipelines
+// still use, is selected back and false is returned. reloaded is then every shader.
+//
+bool App::_useShaderVariant(const std::string& define, const std::string& value, const std::string& tag,
+	const std::string& previousValue, const std::string& previousTag, std::vector<std::string>& reloaded)
+{
+	m_shaderReloader.setDefine(define, value, tag);
+	m_shaderReloader.compileVariant();
+	if (!m_shaderReloader.getLastError().empty()) {
+		LOGW("%s=%s: the shaders of the variant cannot be compiled\n", define.c_str(), value.c_str());
+		m_shaderReloader.setDefine(define, previousValue, previousTag);
+		return false;
+	}
+	reloaded = m_shaderReloader.getShaders();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Switches the shaders to the variant for another number of samples per reservoir, then recreates the
+// reservoir images with a layer per sample. The current size is kept when that fails.
+//
+bool App::_setReservoirSize(uint32_t size)
+{
+	if (size == m_reservoirSize) {
+		return true;
+	}
+	std::vector<std::string> reloaded;
+	auto tag = [](uint32_t k) { return k == RESERVOIR_SIZE ? std::string() : "k" + std::to_string(k); };
+	if (!_useShaderVariant("RESERVOIR_SIZE", std::to_string(size), tag(size),
+		std::to_string(m_reservoirSize), tag(m_reservoirSize), reloaded)) {
+		return false;
+	}
+	LOGI("Reservoir size %u\n", size);
+	m_device.waitIdle();
+	m_reservoirSize = size;
+	m_requestedReservoirSize = int(size);
+	_destroyRenderTargets();
+	_createRenderTargets();
+	_updateRestirDescriptorSet();
+	_rebuildPipelines(reloaded);
+	_resetFrame();
+	return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Switches the target function between the fp32 and the fp16 BRDF, the shading stays in fp32
+//
+bool App::_setHalfPrecisionPHat(bool enable)
+{
+	if (enable == m_halfPrecisionPHat) {
+		return true;
+	}
+	if (enable && !m_supportsFloat16) {
+		LOGW("fp16 target function needs shaderFloat16\n");
+		return false;
+	}
+	std::vector<std::string> reloaded;
+	if (!_useShaderVariant("HALF_PRECISION_PHAT", enable ? "1" : "0", enable ? "fp16" : "",
+		enable ? "0" : "1", enable ? "" : "fp16", reloaded)) {
+		return false;
+	}
+	m_halfPrecisionPHat = enable;
+	m_requestedHalfPrecisionPHat = enable;
+	_rebuildPipelines(reloaded);
+	_resetFrame();
+	return true;
+}
+
 void App::_resetFrame()
 {
 	m_pushC.frame = -1;
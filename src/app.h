@@ -1,8 +1,9 @@
 #pragma once
 #include <vulkan/vulkan.hpp>
 
-#define NVVK_ALLOC_DEDICATED
+#define NVVK_ALLOC_DMA
 #include "nvvk/allocator_vk.hpp"
+#include "nvvk/memorymanagement_vk.hpp"
 #include "nvvk/appbase_vkpp.hpp"
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
@@ -16,17 +17,37 @@
 #include "sceneBuffers.h"
 #include "GBuffer.hpp"
 #include "util.h"
+#include "gpuTimer.h"
+#include "cameraPath.h"
+#include "shaderReloader.h"
+#include "memoryStats.h"
+#include "resolutionController.h"
+#include "renderGraph.h"
+#include "transientMemory.h"
+#include "startupTrace.h"
+
+#include <array>
+#include <chrono>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 
 #include "passes/restirPass.h"
 #include "passes/spatialReusePass.h"
+#include "passes/shadePass.h"
+#include "passes/denoisePass.h"
+#include "passes/lightCullingPass.h"
+#include "passes/lightPresamplePass.h"
+#include "passes/worldGridPass.h"
+#include "passes/giSpatialReusePass.h"
 
 class App : public nvvk::AppBase
 {
+	friend class Benchmark;
 public:
 	constexpr static std::size_t numGBuffers = 2;
+	// frames of pipeline statistics the GPU may be writing while the host reads an older one
+	constexpr static uint32_t numPipelineStatsSlots = 3;
 	App() {};
 	~App() {};
 	void setup(const vk::Instance& instance,
@@ -42,23 +63,85 @@ private:
 
 	void _createDescriptorPool();
 	void _createUniformBuffer();
+	void _createRenderTargets();
+	void _destroyRenderTargets();
+	// formats of the render targets at a resolution, the reservoirs have a layer per sample
+	[[nodiscard]] vk::ImageCreateInfo _colorTargetInfo(vk::Extent2D extent) const;
+	[[nodiscard]] vk::ImageCreateInfo _reservoirTargetInfo(vk::Extent2D extent) const;
 	void _createDescriptorSet();
 	void _createPostPipeline();
 	void _createMainCommandBuffer();
+	nvvk::Texture _createStorageImage(const vk::CommandBuffer& cmdBuf, const vk::ImageCreateInfo& createInfo,
+		vk::ImageViewType viewType = vk::ImageViewType::e2D);
 	void _updateRestirDescriptorSet();
 
+	// Passes of a frame in recording order, the lifetimes of the transient render targets are ranges of them
+	enum FramePass : uint32_t {
+		ePassRestir,
+		ePassSpatialReuse,
+		ePassGISpatialReuse,
+		ePassShade,
+		ePassDenoise,
+		ePassCount
+	};
+	struct TransientTarget {
+		nvvk::Texture* texture;
+		bool reservoir;  // a layer per reservoir sample
+		FramePass firstPass;
+		FramePass lastPass;
+	};
+	std::vector<TransientTarget> _transientTargets();
+	// Images and buffers of _createRenderTargets alive over the whole frame, either a texture or a buffer
+	struct RenderTarget {
+		nvvk::Texture* texture;
+		vk::ImageCreateInfo imageInfo;
+		vk::ImageViewType viewType;
+		nvvk::Buffer* buffer;
+		vk::DeviceSize bufferSize;
+		vk::BufferUsageFlags bufferUsage;
+		const char* name;
+	};
+	std::vector<RenderTarget> _renderTargets(vk::Extent2D extent);
+	void _createTransientTargets(const vk::ImageCreateInfo& colorCreateInfo, const vk::ImageCreateInfo& reservoirCreateInfo);
+	void _destroyTransientTargets();
+	MemoryStats::WorkingSet _estimateWorkingSet(vk::Extent2D extent);
+
+	void _createWorldGrid();
+	void _destroyWorldGrid();
+
 	void _updateUniformBuffer(const vk::CommandBuffer& cmdBuf);
+	void _recordFrame(const vk::CommandBuffer& cmdBuf);
+	void _readCandidateStats();
+	void _readPipelineStats();
+	void _readPHatErrorStats();
+	MemoryStats _collectMemoryStats() const;
+	bool _captureImage(const nvvk::Texture& texture, const std::string& filename);
+	// Writes the per-pixel cost histogram and the cost per material and screen tile of the last frame as JSON
+	bool _exportShaderCost(const std::string& filename);
 
 	void _drawPost(vk::CommandBuffer cmdBuf, uint32_t currentGFrame);
 	void _renderUI();
 	void _submitMainCommand();
+	// Blocks until the main command buffer of the frame completed, 0 returns immediately
+	void _waitForFrame(uint64_t frame);
+	void _resolveGpuTimer();
 
 	void _updateFrame();
 	void _resetFrame();
+	void _updateRenderSize(bool force);
+	void _updateCameraPath();
+	void _reloadShaders(bool force);
+	void _rebuildPipelines(const std::vector<std::string>& reloaded);
+	bool _useShaderVariant(const std::string& define, const std::string& value, const std::string& tag,
+		const std::string& previousValue, const std::string& previousTag, std::vector<std::string>& reloaded);
+	bool _setReservoirSize(uint32_t size);
+	bool _setHalfPrecisionPHat(bool enable);
 
 	void onResize(int /*w*/, int /*h*/) override;
 
-	nvvk::AllocatorDedicated m_alloc;
+	// Resources are sub-allocated from large device memory blocks instead of one allocation each
+	nvvk::DeviceMemoryAllocator m_memAllocator;
+	nvvk::AllocatorDma m_alloc;
 	nvvk::DebugUtil          m_debug;
 
 
@@ -67,6 +150,23 @@ private:
 	bool m_enableSpatialReuse = true;
 	bool m_enableVisibleTest = true;
 	bool m_enableEnvironment = false;
+	bool m_enableDenoiser = false;
+	bool m_enableAdaptiveCandidates = false;
+	bool m_enableLightCulling = false;
+	bool m_enableLightPresampling = false;
+	bool m_enableWorldGrid = false;
+	// the grid buffers are recreated before the next frame when its layout changes
+	bool m_worldGridDirty = false;
+	int m_log2WorldGridCells = 16;
+	bool m_enableGI = false;
+	bool m_enableSubgroupSpatialReuse = false;
+	// light samples per reservoir, changing it recompiles the shaders
+	uint32_t m_reservoirSize = RESERVOIR_SIZE;
+	int m_requestedReservoirSize = RESERVOIR_SIZE;
+	// fp16 BRDF in the target function, also switched by recompiling
+	bool m_supportsFloat16 = false;
+	bool m_halfPrecisionPHat = false;
+	bool m_requestedHalfPrecisionPHat = false;
 
 	int m_log2InitialLightSamples = 5;
 	int m_temporalReuseSampleMultiplier = 20;
@@ -74,6 +174,12 @@ private:
 
 
 
+	// Render targets are allocated at the window size (m_size), frames are rendered at m_renderSize
+	bool m_enableDynamicResolution = false;
+	float m_renderScale = 1.0f;
+	vk::Extent2D m_renderSize;
+	ResolutionController m_resolutionController;
+
 	uint32_t m_currentGBufferFrame = 0;
 	shader::PushConstant m_pushC;
 	shader::SceneUniforms m_sceneUniforms;
@@ -92,7 +198,59 @@ private:
 	std::vector<nvvk::Texture>              m_reservoirWeightBuffers;
 	nvvk::Texture             m_reservoirTmpInfoBuffer;
 	nvvk::Texture             m_reservoirTmpWeightBuffer;
+	// one bounce indirect reservoirs: the final ones per G-buffer frame, the raygen output before the spatial reuse
+	std::vector<nvvk::Texture>              m_giReservoirSampleBuffers;
+	std::vector<nvvk::Texture>              m_giReservoirRadianceBuffers;
+	nvvk::Texture             m_giReservoirTmpSampleBuffer;
+	nvvk::Texture             m_giReservoirTmpRadianceBuffer;
 	nvvk::Texture m_storageImage;
+	nvvk::Texture m_radianceImage;
+	// memory of the targets of _transientTargets(), shared by the ones not alive at the same time
+	TransientMemory m_transientMemory;
+	std::vector<MemoryStats::WorkingSet> m_workingSets;
+
+	std::vector<nvvk::Texture>              m_denoiseHistoryColorBuffers;
+	std::vector<nvvk::Texture>              m_denoiseHistoryMomentsBuffers;
+	nvvk::Texture             m_denoisePingBuffer;
+	nvvk::Texture             m_denoisePongBuffer;
+	nvvk::Texture             m_denoiseOutputBuffer;
+
+	nvvk::Texture             m_candidateBudgetBuffer;
+	// clock cycles per pixel and phase, recorded while the debug mode shows them
+	nvvk::Texture             m_shaderCostImage;
+	bool                      m_exportShaderCost = false;
+	nvvk::Buffer              m_candidateStatsBuffer;
+	shader::CandidateStats*   m_candidateStats = nullptr;
+	float                     m_averageCandidates = 0.0f;
+
+	// counted by the restir and spatial reuse passes when the subgroups of both support the arithmetic operations.
+	// Each frame copies its counters to a host visible slot, read once the frame timeline passed the frame.
+	bool                      m_supportsPipelineStats = false;
+	bool                      m_enablePipelineStats = false;
+	nvvk::Buffer              m_pipelineStatsBuffer;
+	nvvk::Buffer              m_pipelineStatsReadbackBuffer;
+	const shader::PipelineStats* m_pipelineStatsSlots = nullptr;
+	std::array<uint64_t, numPipelineStatsSlots> m_pipelineStatsSlotFrames{};
+	// the most recent frame read, 0 for none
+	shader::PipelineStats     m_pipelineStats{};
+	uint64_t                  m_pipelineStatsFrame = 0;
+
+	// relative error of the fp16 target function, measured by the shade pass in the fp16 error debug view
+	// or for the benchmark. The values are those of the last frame that measured samples.
+	bool                      m_measurePHatError = false;
+	nvvk::Buffer              m_pHatErrorStatsBuffer;
+	shader::PHatErrorStats*   m_pHatErrorStats = nullptr;
+	float                     m_pHatErrorMean = 0.0f;
+	float                     m_pHatErrorMax = 0.0f;
+	uint32_t                  m_pHatErrorSamples = 0;
+	uint32_t                  m_pHatErrorZeroed = 0;
+
+	// per froxel light counts and alias tables, sized for the froxels of the window size
+	nvvk::Buffer              m_lightCellCountBuffer;
+	nvvk::Buffer              m_lightCellEntryBuffer;
+	nvvk::Buffer              m_presampledLightBuffer;
+	nvvk::Buffer              m_worldGridCellBuffer;
+	nvvk::Buffer              m_worldGridReservoirBuffer;
 
 	//Descriptors
 	vk::DescriptorPool          m_descStaticPool;
@@ -114,19 +272,41 @@ private:
 	vk::PipelineLayout          m_postPipelineLayout;
 
 	vk::CommandBuffer m_mainCommandBuffer;
-	vk::Fence m_mainFence;
+	// signaled with the number of the frame, counted from 1, when its main command buffer completes
+	vk::Semaphore m_frameTimeline;
+	uint64_t m_submittedFrames = 0;
+	std::chrono::steady_clock::time_point m_frameSubmitTime;
+	// time blocked in the last wait, and from the submission of the waited frame to the end of the wait.
+	// Both include the wait for the timestamps in _resolveGpuTimer.
+	double m_frameWaitMs = 0.0;
+	double m_frameLatencyMs = 0.0;
 
 	//Pass
 	RestirPass m_restirPass;
 	SpatialReusePass m_spatialReusePass;
-
-	void _initReservior(shader::Reservoir& reseovir) {
-		reseovir.numStreamSamples = 0;
-			reseovir.lightIndex = 0;
-			reseovir.pHat = 0.0;
-			reseovir.sumWeights = 0.0;
-			reseovir.w = 0.0;
-		
-	}
+	ShadePass m_shadePass;
+	DenoisePass m_denoisePass;
+	LightCullingPass m_lightCullingPass;
+	LightPresamplePass m_lightPresamplePass;
+	WorldGridPass m_worldGridPass;
+	GISpatialReusePass m_giSpatialReusePass;
+
+	GpuTimer m_gpuTimer;
+	RenderGraph m_renderGraph;
+
+	//Camera path
+	CameraPath m_cameraPath;
+	char m_cameraPathFile[256] = "camera_path.txt";
+	bool m_recordingPath = false;
+	bool m_playingPath = false;
+	bool m_loopPath = false;
+	int m_pathFrame = 0;
+	float m_pathTimestep = 1.0f / 60.0f;
+	float m_pathRecordInterval = 1.0f / 30.0f;
+	std::chrono::steady_clock::time_point m_pathRecordStart;
+
+	ShaderReloader m_shaderReloader;
+	bool m_enableShaderReload = false;
+	bool m_forceShaderReload = false;
 
 };
@@ -0,0 +1,256 @@
+#include "asBuilder.h"
+#include "startupTrace.h"
+#include "nvh/nvprint.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static vk::DeviceSize alignUp(vk::DeviceSize x, vk::DeviceSize a) {
+	return (x + a - 1) / a * a;
+}
+
+void AsBuilder::setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, nvvk::AllocatorDma* allocator, uint32_t queueIndex) {
+	m_device = device;
+	m_alloc = allocator;
+	m_queueIndex = queueIndex;
+
+	auto properties = physicalDevice.getProperties2<vk::PhysicalDeviceProperties2,
+		vk::PhysicalDeviceAccelerationStructurePropertiesKHR>();
+	m_scratchAlignment = std::max<vk::DeviceSize>(1,
+		properties.get<vk::PhysicalDeviceAccelerationStructurePropertiesKHR>().minAccelerationStructureScratchOffsetAlignment);
+}
+
+void AsBuilder::_track(vk::DeviceSize allocated) {
+	m_liveBytes += allocated;
+	m_stats.peakBytes = std::max(m_stats.peakBytes, m_liveBytes);
+}
+
+void AsBuilder::_release(vk::DeviceSize released) {
+	m_liveBytes -= released;
+}
+
+void AsBuilder::buildBlas(const std::vector<BlasInput>& inputs, vk::BuildAccelerationStructureFlagsKHR flags, vk::DeviceSize scratchBudget) {
+	flags |= vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction;
+	const uint32_t blasCount = static_cast<uint32_t>(inputs.size());
+	m_blas.resize(blasCount);
+	m_stats.blasCount = blasCount;
+	if (blasCount == 0) {
+		return;
+	}
+
+	std::vector<vk::AccelerationStructureBuildGeometryInfoKHR> buildInfos(blasCount);
+	std::vector<vk::AccelerationStructureBuildSizesInfoKHR> sizeInfos(blasCount);
+	std::vector<vk::DeviceSize> scratchSizes(blasCount);
+	vk::DeviceSize maxScratch = 0;
+	vk::DeviceSize totalScratch = 0;
+	for (uint32_t i = 0; i < blasCount; i++) {
+		buildInfos[i]
+			.setType(vk::AccelerationStructureTypeKHR::eBottomLevel)
+			.setFlags(flags)
+			.setMode(vk::BuildAccelerationStructureModeKHR::eBuild)
+			.setGeometries(inputs[i].asGeometry);
+
+		std::vector<uint32_t> maxPrimCount;
+		maxPrimCount.reserve(inputs[i].asBuildOffsetInfo.size());
+		for (const auto& range : inputs[i].asBuildOffsetInfo) {
+			maxPrimCount.push_back(range.primitiveCount);
+		}
+		sizeInfos[i] = m_device.getAccelerationStructureBuildSizesKHR(
+			vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfos[i], maxPrimCount);
+		scratchSizes[i] = alignUp(sizeInfos[i].buildScratchSize, m_scratchAlignment);
+		maxScratch = std::max(maxScratch, scratchSizes[i]);
+		totalScratch += scratchSizes[i];
+	}
+
+	// A single BLAS larger than the budget still has to be built, so the budget is only a soft cap
+	const vk::DeviceSize scratchSize = std::min(std::max(scratchBudget, maxScratch), totalScratch);
+	nvvk::Buffer scratchBuffer = m_alloc->createBuffer(scratchSize,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress);
+	_track(scratchSize);
+	m_stats.scratchBytes = scratchSize;
+	const vk::DeviceAddress scratchAddress = m_device.getBufferAddress({ scratchBuffer.buffer });
+
+	vk::QueryPool queryPool = m_device.createQueryPool(
+		{ {}, vk::QueryType::eAccelerationStructureCompactedSizeKHR, blasCount });
+
+	uint32_t next = 0;
+	while (next < blasCount) {
+		// Gather BLASes until the batch scratch no longer fits
+		const uint32_t first = next;
+		vk::DeviceSize batchScratch = 0;
+		while (next < blasCount && (next == first || batchScratch + scratchSizes[next] <= scratchSize)) {
+			batchScratch += scratchSizes[next];
+			next++;
+		}
+		const uint32_t batchCount = next - first;
+
+		std::vector<nvvk::AccelKHR> uncompacted(batchCount);
+		std::vector<vk::AccelerationStructureKHR> uncompactedHandles(batchCount);
+		{
+			nvvk::CommandPool cmdBufGet(m_device, m_queueIndex);
+			vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
+			cmdBuf.resetQueryPool(queryPool, 0, batchCount);
+			startupTrace.beginGpu(cmdBuf, "BLAS Batch Build");
+
+			vk::DeviceSize scratchOffset = 0;
+			for (uint32_t b = 0; b < batchCount; b++) {
+				const uint32_t idx = first + b;
+				vk::AccelerationStructureCreateInfoKHR createInfo;
+				createInfo.setType(vk::AccelerationStructureTypeKHR::eBottomLevel);
+				createInfo.setSize(sizeInfos[idx].accelerationStructureSize);
+				uncompacted[b] = m_alloc->createAcceleration(createInfo);
+				uncompactedHandles[b] = uncompacted[b].accel;
+				_track(sizeInfos[idx].accelerationStructureSize);
+				m_stats.uncompactedBlasBytes += sizeInfos[idx].accelerationStructureSize;
+
+				buildInfos[idx].setDstAccelerationStructure(uncompacted[b].accel);
+				buildInfos[idx].scratchData.setDeviceAddress(scratchAddress + scratchOffset);
+				scratchOffset += scratchSizes[idx];
+
+				const vk::AccelerationStructureBuildRangeInfoKHR* pBuildOffset = inputs[idx].asBuildOffsetInfo.data();
+				cmdBuf.buildAccelerationStructuresKHR(1, &buildInfos[idx], &pBuildOffset);
+			}
+
+			// The compacted size can only be queried once the builds are finished
+			vk::MemoryBarrier barrier;
+			barrier.setSrcAccessMask(vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+			barrier.setDstAccessMask(vk::AccessFlagBits::eAccelerationStructureReadKHR);
+			cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR,
+				vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, {}, { barrier }, {}, {});
+			cmdBuf.writeAccelerationStructuresPropertiesKHR(uncompactedHandles,
+				vk::QueryType::eAccelerationStructureCompactedSizeKHR, queryPool, 0);
+			startupTrace.endGpu(cmdBuf);
+			cmdBufGet.submitAndWait(cmdBuf);
+			startupTrace.resolveGpu();
+		}
+
+		std::vector<vk::DeviceSize> compactSizes(batchCount);
+		vk::Result result = m_device.getQueryPoolResults(queryPool, 0, batchCount,
+			compactSizes.size() * sizeof(vk::DeviceSize), compactSizes.data(), sizeof(vk::DeviceSize),
+			vk::QueryResultFlagBits::eWait | vk::QueryResultFlagBits::e64);
+		if (result != vk::Result::eSuccess)
+			LOGE("Fail getQueryPoolResults: %s", vk::to_string(result).c_str());
+
+		{
+			nvvk::CommandPool cmdBufGet(m_device, m_queueIndex);
+			vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
+			startupTrace.beginGpu(cmdBuf, "BLAS Batch Compaction");
+			for (uint32_t b = 0; b < batchCount; b++) {
+				vk::AccelerationStructureCreateInfoKHR createInfo;
+				createInfo.setType(vk::AccelerationStructureTypeKHR::eBottomLevel);
+				createInfo.setSize(compactSizes[b]);
+				m_blas[first + b] = m_alloc->createAcceleration(createInfo);
+				_track(compactSizes[b]);
+				m_stats.compactedBlasBytes += compactSizes[b];
+
+				vk::CopyAccelerationStructureInfoKHR copyInfo;
+				copyInfo.setSrc(uncompacted[b].accel);
+				copyInfo.setDst(m_blas[first + b].accel);
+				copyInfo.setMode(vk::CopyAccelerationStructureModeKHR::eCompact);
+				cmdBuf.copyAccelerationStructureKHR(copyInfo);
+			}
+			startupTrace.endGpu(cmdBuf);
+			cmdBufGet.submitAndWait(cmdBuf);
+			startupTrace.resolveGpu();
+		}
+
+		for (uint32_t b = 0; b < batchCount; b++) {
+			m_alloc->destroy(uncompacted[b]);
+			_release(sizeInfos[first + b].accelerationStructureSize);
+		}
+		m_stats.batchCount++;
+	}
+
+	m_device.destroy(queryPool);
+	m_alloc->destroy(scratchBuffer);
+	_release(scratchSize);
+	m_alloc->finalizeAndReleaseStaging();
+
+	m_stats.steadyBytes = m_stats.compactedBlasBytes;
+}
+
+void AsBuilder::buildTlas(const std::vector<Instance>& instances, vk::BuildAccelerationStructureFlagsKHR flags) {
+	std::vector<vk::AccelerationStructureInstanceKHR> geometryInstances;
+	geometryInstances.reserve(instances.size());
+	for (const Instance& inst : instances) {
+		vk::AccelerationStructureInstanceKHR gInst;
+		// The matrices for the instance transforms are row-major, instead of column-major
+		nvmath::mat4f transp = nvmath::transpose(inst.transform);
+		memcpy(&gInst.transform, &transp, sizeof(gInst.transform));
+		gInst.setInstanceCustomIndex(inst.instanceCustomId);
+		gInst.setMask(inst.mask);
+		gInst.setInstanceShaderBindingTableRecordOffset(inst.hitGroupId);
+		gInst.setFlags(static_cast<VkGeometryInstanceFlagsKHR>(inst.flags));
+		gInst.setAccelerationStructureReference(m_device.getAccelerationStructureAddressKHR({ m_blas[inst.blasId].accel }));
+		geometryInstances.push_back(gInst);
+	}
+	const uint32_t instanceCount = static_cast<uint32_t>(geometryInstances.size());
+
+	nvvk::CommandPool cmdBufGet(m_device, m_queueIndex);
+	vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
+	startupTrace.beginGpu(cmdBuf, "TLAS Build");
+
+	m_instBuffer = m_alloc->createBuffer(cmdBuf, geometryInstances,
+		vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR);
+	const vk::DeviceSize instBytes = geometryInstances.size() * sizeof(vk::AccelerationStructureInstanceKHR);
+	_track(instBytes);
+
+	// Make sure the copy of the instance buffer is done before building the TLAS
+	vk::MemoryBarrier barrier;
+	barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+	barrier.setDstAccessMask(vk::AccessFlagBits::eAccelerationStructureWriteKHR);
+	cmdBuf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+		vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, {}, { barrier }, {}, {});
+
+	vk::AccelerationStructureGeometryInstancesDataKHR instancesVk{ VK_FALSE, m_device.getBufferAddress({ m_instBuffer.buffer }) };
+	vk::AccelerationStructureGeometryKHR topASGeometry{ vk::GeometryTypeKHR::eInstances };
+	topASGeometry.geometry.setInstances(instancesVk);
+
+	vk::AccelerationStructureBuildGeometryInfoKHR buildInfo;
+	buildInfo.setType(vk::AccelerationStructureTypeKHR::eTopLevel);
+	buildInfo.setFlags(flags);
+	buildInfo.setMode(vk::BuildAccelerationStructureModeKHR::eBuild);
+	buildInfo.setGeometries(topASGeometry);
+
+	vk::AccelerationStructureBuildSizesInfoKHR sizeInfo = m_device.getAccelerationStructureBuildSizesKHR(
+		vk::AccelerationStructureBuildTypeKHR::eDevice, buildInfo, instanceCount);
+
+	vk::AccelerationStructureCreateInfoKHR createInfo;
+	createInfo.setType(vk::AccelerationStructureTypeKHR::eTopLevel);
+	createInfo.setSize(sizeInfo.accelerationStructureSize);
+	m_tlas = m_alloc->createAcceleration(createInfo);
+	_track(sizeInfo.accelerationStructureSize);
+	m_stats.tlasBytes = sizeInfo.accelerationStructureSize;
+
+	const vk::DeviceSize scratchSize = alignUp(sizeInfo.buildScratchSize, m_scratchAlignment);
+	nvvk::Buffer scratchBuffer = m_alloc->createBuffer(scratchSize,
+		vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress);
+	_track(scratchSize);
+
+	buildInfo.setDstAccelerationStructure(m_tlas.accel);
+	buildInfo.scratchData.setDeviceAddress(m_device.getBufferAddress({ scratchBuffer.buffer }));
+
+	vk::AccelerationStructureBuildRangeInfoKHR buildOffsetInfo{ instanceCount, 0, 0, 0 };
+	const vk::AccelerationStructureBuildRangeInfoKHR* pBuildOffsetInfo = &buildOffsetInfo;
+	cmdBuf.buildAccelerationStructuresKHR(1, &buildInfo, &pBuildOffsetInfo);
+
+	startupTrace.endGpu(cmdBuf);
+	cmdBufGet.submitAndWait(cmdBuf);
+	startupTrace.resolveGpu();
+	m_alloc->finalizeAndReleaseStaging();
+	m_alloc->destroy(scratchBuffer);
+	_release(scratchSize);
+
+	m_stats.steadyBytes = m_stats.compactedBlasBytes + m_stats.tlasBytes + instBytes;
+}
+
+void AsBuilder::destroy() {
+	for (auto& b : m_blas) {
+		m_alloc->destroy(b);
+	}
+	m_blas.clear();
+	m_alloc->destroy(m_tlas);
+	m_alloc->destroy(m_instBuffer);
+	m_stats = Stats{};
+	m_liveBytes = 0;
+}
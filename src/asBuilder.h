@@ -0,0 +1,71 @@
+#pragma once
+#define NVVK_ALLOC_DMA
+#include <vulkan/vulkan.hpp>
+#include <nvmath/nvmath.h>
+#include "nvvk/allocator_vk.hpp"
+#include "nvvk/commands_vk.hpp"
+
+#include <vector>
+
+// Acceleration structure builder.
+// BLASes are built in batches whose total scratch size stays under a budget,
+// then compacted, so the uncompacted AS and scratch memory never exist for the whole scene at once.
+class AsBuilder {
+public:
+	struct BlasInput {
+		std::vector<vk::AccelerationStructureGeometryKHR>       asGeometry;
+		std::vector<vk::AccelerationStructureBuildRangeInfoKHR> asBuildOffsetInfo;
+	};
+
+	struct Instance {
+		uint32_t                   blasId{ 0 };
+		uint32_t                   instanceCustomId{ 0 };
+		uint32_t                   hitGroupId{ 0 };
+		uint32_t                   mask{ 0xFF };
+		vk::GeometryInstanceFlagsKHR flags{};
+		nvmath::mat4f              transform{ nvmath::mat4f(1) };
+	};
+
+	struct Stats {
+		uint32_t       blasCount{ 0 };
+		uint32_t       batchCount{ 0 };
+		vk::DeviceSize uncompactedBlasBytes{ 0 };
+		vk::DeviceSize compactedBlasBytes{ 0 };
+		vk::DeviceSize tlasBytes{ 0 };
+		vk::DeviceSize scratchBytes{ 0 };
+		// Highest amount of AS + scratch + instance memory alive at once during the build
+		vk::DeviceSize peakBytes{ 0 };
+		// AS memory kept after the build
+		vk::DeviceSize steadyBytes{ 0 };
+	};
+
+	void setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, nvvk::AllocatorDma* allocator, uint32_t queueIndex);
+
+	void buildBlas(const std::vector<BlasInput>& inputs, vk::BuildAccelerationStructureFlagsKHR flags, vk::DeviceSize scratchBudget);
+	void buildTlas(const std::vector<Instance>& instances, vk::BuildAccelerationStructureFlagsKHR flags);
+
+	[[nodiscard]] vk::AccelerationStructureKHR getAccelerationStructure() const {
+		return m_tlas.accel;
+	}
+	[[nodiscard]] const Stats& getStats() const {
+		return m_stats;
+	}
+
+	void destroy();
+
+private:
+	vk::Device m_device;
+	nvvk::AllocatorDma* m_alloc = nullptr;
+	uint32_t m_queueIndex = 0;
+	vk::DeviceSize m_scratchAlignment = 1;
+
+	std::vector<nvvk::AccelKHR> m_blas;
+	nvvk::AccelKHR m_tlas;
+	nvvk::Buffer m_instBuffer;
+
+	Stats m_stats;
+	vk::DeviceSize m_liveBytes = 0;
+
+	void _track(vk::DeviceSize allocated);
+	void _release(vk::DeviceSize released);
+};
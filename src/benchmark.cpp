@@ -0,0 +1,439 @@
+#include "benchmark.h"
+#include "app.h"
+#include "cameraPath.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "nvh/cameramanipulator.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+// user and kernel time of all the threads of the process
+double processCpuMs() {
+#ifdef _WIN32
+	FILETIME creation, exitTime, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user);
+	auto ticks = [](const FILETIME& time) { return (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+	// 100 ns ticks
+	return double(ticks(kernel) + ticks(user)) / 10000.0;
+#else
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	auto ms = [](const timeval& time) { return double(time.tv_sec) * 1000.0 + double(time.tv_usec) / 1000.0; };
+	return ms(usage.ru_utime) + ms(usage.ru_stime);
+#endif
+}
+}  // namespace
+
+Benchmark::Benchmark(App& app, GLFWwindow* window, std::string scene, std::string output)
+	: m_app(app), m_window(window), m_scene(std::move(scene)), m_output(std::move(output)) {
+}
+
+std::vector<Benchmark::Config> Benchmark::defaultConfigs() {
+	std::vector<Config> configs;
+	configs.push_back({ "default" });
+
+	Config noReuse{ "no_reuse" };
+	noReuse.temporalReuse = false;
+	noReuse.spatialReuse = false;
+	configs.push_back(noReuse);
+
+	Config noVisibility{ "no_visibility_test" };
+	noVisibility.visibilityTest = false;
+	configs.push_back(noVisibility);
+
+	Config denoiser{ "denoiser" };
+	denoiser.denoiser = true;
+	configs.push_back(denoiser);
+
+	Config checkerboard{ "checkerboard" };
+	checkerboard.generationMode = GENERATION_MODE_CHECKERBOARD;
+	configs.push_back(checkerboard);
+
+	Config quarter{ "quarter" };
+	quarter.generationMode = GENERATION_MODE_QUARTER;
+	configs.push_back(quarter);
+
+	Config adaptive{ "adaptive_candidates" };
+	adaptive.adaptiveCandidates = true;
+	configs.push_back(adaptive);
+
+	Config lightCulling{ "light_culling" };
+	lightCulling.lightCulling = true;
+	configs.push_back(lightCulling);
+
+	Config lightPresampling{ "light_presampling" };
+	lightPresampling.lightPresampling = true;
+	configs.push_back(lightPresampling);
+
+	Config worldGrid{ "world_grid" };
+	worldGrid.worldGrid = true;
+	configs.push_back(worldGrid);
+
+	Config gi{ "gi" };
+	gi.gi = true;
+	configs.push_back(gi);
+
+	// the neighbor merge loop of spatialReuse.comp runs with the spatial reuse flag off,
+	// the per-thread and the subgroup kernels are compared there at the same neighbor count
+	Config neighborMerge{ "neighbor_merge" };
+	neighborMerge.spatialReuse = false;
+	configs.push_back(neighborMerge);
+
+	Config subgroupNeighborMerge{ "subgroup_neighbor_merge" };
+	subgroupNeighborMerge.spatialReuse = false;
+	subgroupNeighborMerge.subgroupSpatialReuse = true;
+	configs.push_back(subgroupNeighborMerge);
+
+	// cost and error per number of samples per reservoir
+	for (uint32_t size : { 2u, 4u }) {
+		Config reservoirSize{ "reservoir_k" + std::to_string(size) };
+		reservoirSize.reservoirSize = size;
+		configs.push_back(reservoirSize);
+	}
+
+	// throughput of the fp16 target function, its relative error to fp32 is measured after the timed frames
+	Config halfPrecisionPHat{ "half_precision_phat" };
+	halfPrecisionPHat.halfPrecisionPHat = true;
+	configs.push_back(halfPrecisionPHat);
+	return configs;
+}
+
+// Without a camera path: one orbit around the scene center, inside the bounds so interiors are benchmarked from within.
+void Benchmark::_applyCamera(float t) const {
+	if (m_cameraPath != nullptr) {
+		m_cameraPath->apply(t * m_cameraPath->getDuration());
+		return;
+	}
+	const auto& dim = m_app.m_gltfScene.m_dimensions;
+	float angle = t * 2.0f * nv_pi;
+	float radius = 0.25f * std::max(dim.size.x, dim.size.z);
+	nvmath::vec3f eye = dim.center + nvmath::vec3f(std::cos(angle) * radius, 0.1f * dim.size.y, std::sin(angle) * radius);
+	CameraManip.setLookat(eye, dim.center, nvmath::vec3f(0, 1, 0));
+}
+
+bool Benchmark::_applyConfig(const Config& config) {
+	if (config.subgroupSpatialReuse && !m_app.m_spatialReusePass.supportsSubgroupSharing()) {
+		std::cerr << "Benchmark: " << config.name << " skipped, the device has no compute subgroup shuffles" << std::endl;
+		return false;
+	}
+	if (!m_app._setReservoirSize(config.reservoirSize)) {
+		std::cerr << "Benchmark: " << config.name << " skipped, " << config.reservoirSize << " samples per reservoir need shaderc" << std::endl;
+		return false;
+	}
+	if (!m_app._setHalfPrecisionPHat(config.halfPrecisionPHat)) {
+		std::cerr << "Benchmark: " << config.name << " skipped, the fp16 target function needs shaderFloat16 and shaderc" << std::endl;
+		return false;
+	}
+	m_app.m_enableTemporalReuse = config.temporalReuse;
+	m_app.m_enableSpatialReuse = config.spatialReuse;
+	m_app.m_enableVisibleTest = config.visibilityTest;
+	m_app.m_enableDenoiser = config.denoiser;
+	m_app.m_enableAdaptiveCandidates = config.adaptiveCandidates;
+	m_app.m_enableLightCulling = config.lightCulling;
+	m_app.m_enableLightPresampling = config.lightPresampling;
+	m_app.m_enableWorldGrid = config.worldGrid;
+	m_app.m_enableGI = config.gi;
+	m_app.m_enableSubgroupSpatialReuse = config.subgroupSpatialReuse;
+	m_app.m_enablePipelineStats = m_pipelineStats && m_app.m_supportsPipelineStats;
+	m_app.m_sceneUniforms.generationMode = config.generationMode;
+	m_app.m_log2InitialLightSamples = config.log2InitialLightSamples;
+	// every configuration is measured at the full window resolution
+	m_app.m_enableDynamicResolution = false;
+	m_app.m_renderScale = 1.0f;
+	m_app.m_sceneUniforms.frameIndex = 0;
+	m_app._resetFrame();
+	return true;
+}
+
+double Benchmark::_renderFrame() {
+	glfwPollEvents();
+	if (glfwWindowShouldClose(m_window)) {
+		return -1.0;
+	}
+	m_app.render();
+	m_app._waitForFrame(m_app.m_submittedFrames);
+	m_app._resolveGpuTimer();
+	return m_app.m_gpuTimer.getTotal();
+}
+
+bool Benchmark::runConvergence(const std::vector<Config>& configs, int referenceFrames) {
+	std::filesystem::create_directories(m_output);
+	std::ofstream manifest(m_output + "/captures.csv");
+	if (!manifest) {
+		std::cerr << "Convergence: cannot write " << m_output << "/captures.csv" << std::endl;
+		return false;
+	}
+	manifest << "config,frame,gpuMs,file\n";
+
+	_applyCamera(0.0f);
+	std::cout << "Convergence " << m_scene << " [reference, " << referenceFrames << " frames]" << std::endl;
+	_applyConfig(Config{ "reference" });
+	for (int i = 0; i < referenceFrames; ++i) {
+		if (_renderFrame() < 0.0) {
+			return false;
+		}
+	}
+	if (!m_app._captureImage(m_app.m_storageImage, m_output + "/reference.pfm")) {
+		return false;
+	}
+
+	for (const Config& config : configs) {
+		std::cout << "Convergence " << m_scene << " [" << config.name << "]" << std::endl;
+		if (!_applyConfig(config)) {
+			continue;
+		}
+		// the first frame after a reset only initializes the accumulation
+		if (_renderFrame() < 0.0) {
+			return false;
+		}
+		double elapsedGpuMs = 0.0;
+		for (int frame = 1; frame <= m_frameCount; ++frame) {
+			double gpuMs = _renderFrame();
+			if (gpuMs < 0.0) {
+				return false;
+			}
+			elapsedGpuMs += gpuMs;
+			bool capture = (frame & (frame - 1)) == 0 || frame == m_frameCount;
+			if (!capture) {
+				continue;
+			}
+			std::string file = config.name + "_" + std::to_string(frame) + ".pfm";
+			const nvvk::Texture& image = config.denoiser ? m_app.m_denoiseOutputBuffer : m_app.m_storageImage;
+			if (!m_app._captureImage(image, m_output + "/" + file)) {
+				return false;
+			}
+			manifest << config.name << "," << frame << "," << elapsedGpuMs << "," << file << "\n";
+		}
+	}
+	std::cout << "Convergence captures written to " << m_output << std::endl;
+	return true;
+}
+
+bool Benchmark::run(const std::vector<Config>& configs) {
+	using Clock = std::chrono::high_resolution_clock;
+	std::vector<std::vector<FrameResult>> results(configs.size());
+	std::vector<PHatError> pHatErrors(configs.size());
+	if (m_pipelineStats && !m_app.m_supportsPipelineStats) {
+		std::cerr << "Benchmark: no pipeline statistics, the device has no subgroup arithmetic in ray generation shaders" << std::endl;
+	}
+
+	for (std::size_t c = 0; c < configs.size(); ++c) {
+		const Config& config = configs[c];
+		std::cout << "Benchmark " << m_scene << " [" << config.name << "]" << std::endl;
+
+		if (!_applyConfig(config)) {
+			continue;
+		}
+
+		for (int i = -m_warmupFrames; i < m_frameCount; ++i) {
+			glfwPollEvents();
+			if (glfwWindowShouldClose(m_window)) {
+				return false;
+			}
+			_applyCamera(std::max(i, 0) / float(m_frameCount));
+
+			auto start = Clock::now();
+			double processStart = processCpuMs();
+			m_app.render();
+			double cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (i < 0) {
+				continue;
+			}
+			m_app._waitForFrame(m_app.m_submittedFrames);
+			m_app._resolveGpuTimer();
+			// a busy wait shows here, a blocking one does not
+			double processMs = processCpuMs() - processStart;
+			// the frame just completed, its slot is the most recent one
+			m_app._readPipelineStats();
+			results[c].push_back({ cpuMs, processMs, m_app.m_frameWaitMs, m_app.m_frameLatencyMs, m_app.m_gpuTimer.getTimes(), m_app.m_pipelineStats });
+		}
+
+		// the second evaluation and the atomics would add to the timings of the measured frames
+		if (config.halfPrecisionPHat) {
+			m_app.m_measurePHatError = true;
+			m_app.m_pHatErrorSamples = 0;
+			double gpuMs = _renderFrame();
+			m_app.m_measurePHatError = false;
+			if (gpuMs < 0.0) {
+				return false;
+			}
+			m_app._readPHatErrorStats();
+			pHatErrors[c] = { m_app.m_pHatErrorSamples > 0, m_app.m_pHatErrorMean, m_app.m_pHatErrorMax,
+				m_app.m_pHatErrorSamples, m_app.m_pHatErrorZeroed };
+		}
+	}
+	return _write(configs, results, pHatErrors);
+}
+
+bool Benchmark::_write(const std::vector<Config>& configs, const std::vector<std::vector<FrameResult>>& results,
+	const std::vector<PHatError>& pHatErrors) const {
+	std::ofstream out(m_output);
+	if (!out) {
+		std::cerr << "Benchmark: cannot write " << m_output << std::endl;
+		return false;
+	}
+	const AsBuilder::Stats& asStats = m_app.m_sceneBuffers.getAsStats();
+	const MemoryStats memStats = m_app._collectMemoryStats();
+	auto str = [](bool b) { return b ? "true" : "false"; };
+
+	out << "{\n";
+	out << "\t\"scene\": \"" << m_scene << "\",\n";
+	out << "\t\"resolution\": [" << m_app.m_size.width << ", " << m_app.m_size.height << "],\n";
+	out << "\t\"frames\": " << m_frameCount << ",\n";
+	out << "\t\"cameraPath\": \"" << (m_cameraPath != nullptr ? "file" : "orbit") << "\",\n";
+	out << "\t\"memory\": {\n";
+	out << "\t\t\"blasCount\": " << asStats.blasCount << ",\n";
+	out << "\t\t\"blasBytes\": " << asStats.compactedBlasBytes << ",\n";
+	out << "\t\t\"tlasBytes\": " << asStats.tlasBytes << ",\n";
+	out << "\t\t\"asBuildPeakBytes\": " << asStats.peakBytes << ",\n";
+	out << "\t\t\"geometryBytes\": " << memStats.geometry << ",\n";
+	out << "\t\t\"textureBytes\": " << memStats.textures << ",\n";
+	out << "\t\t\"accelerationStructureBytes\": " << memStats.accelerationStructures << ",\n";
+	out << "\t\t\"gBufferBytes\": " << memStats.gBuffer << ",\n";
+	out << "\t\t\"reservoirBytes\": " << memStats.reservoirs << ",\n";
+	out << "\t\t\"renderTargetBytes\": " << memStats.renderTargets << ",\n";
+	out << "\t\t\"transientBytes\": " << memStats.transient << ",\n";
+	out << "\t\t\"transientUnaliasedBytes\": " << memStats.transientUnaliased << ",\n";
+	out << "\t\t\"totalBytes\": " << memStats.total() << ",\n";
+	out << "\t\t\"allocatedBlockBytes\": " << memStats.allocatedBlockBytes << ",\n";
+	out << "\t\t\"usedBlockBytes\": " << memStats.usedBlockBytes << ",\n";
+	out << "\t\t\"workingSets\": [";
+	for (std::size_t i = 0; i < memStats.workingSets.size(); ++i) {
+		const MemoryStats::WorkingSet& workingSet = memStats.workingSets[i];
+		out << (i == 0 ? "\n" : ",\n") << "\t\t\t{ \"resolution\": [" << workingSet.extent.width << ", " << workingSet.extent.height
+			<< "], \"bytes\": " << workingSet.bytes << ", \"aliasedBytes\": " << workingSet.aliasedBytes << " }";
+	}
+	out << "\n\t\t],\n";
+	out << "\t\t\"heaps\": [";
+	for (std::size_t i = 0; i < memStats.heaps.size(); ++i) {
+		const MemoryStats::Heap& heap = memStats.heaps[i];
+		out << (i == 0 ? "\n" : ",\n") << "\t\t\t{ \"size\": " << heap.size << ", \"deviceLocal\": " << str(heap.deviceLocal);
+		if (memStats.budgetSupported) {
+			out << ", \"budget\": " << heap.budget << ", \"usage\": " << heap.usage;
+		}
+		out << " }";
+	}
+	out << "\n\t\t]\n";
+	out << "\t},\n";
+	out << "\t\"configs\": [\n";
+	for (std::size_t c = 0; c < configs.size(); ++c) {
+		const Config& config = configs[c];
+		const std::vector<FrameResult>& frames = results[c];
+
+		double cpuSum = 0.0;
+		double processCpuSum = 0.0;
+		double waitSum = 0.0;
+		double latencySum = 0.0;
+		std::vector<std::pair<std::string, double>> gpuSum;
+		for (const FrameResult& frame : frames) {
+			cpuSum += frame.cpuMs;
+			processCpuSum += frame.processCpuMs;
+			waitSum += frame.waitMs;
+			latencySum += frame.latencyMs;
+			for (const auto& pass : frame.gpuMs) {
+				auto it = std::find_if(gpuSum.begin(), gpuSum.end(), [&](const auto& p) { return p.first == pass.first; });
+				if (it == gpuSum.end()) {
+					gpuSum.emplace_back(pass.first, pass.second);
+				}
+				else {
+					it->second += pass.second;
+				}
+			}
+		}
+		double frameCount = std::max<double>(1.0, double(frames.size()));
+
+		out << "\t\t{\n";
+		out << "\t\t\t\"name\": \"" << config.name << "\",\n";
+		out << "\t\t\t\"settings\": { \"temporalReuse\": " << str(config.temporalReuse)
+			<< ", \"spatialReuse\": " << str(config.spatialReuse)
+			<< ", \"visibilityTest\": " << str(config.visibilityTest)
+			<< ", \"denoiser\": " << str(config.denoiser)
+			<< ", \"adaptiveCandidates\": " << str(config.adaptiveCandidates)
+			<< ", \"lightCulling\": " << str(config.lightCulling)
+			<< ", \"lightPresampling\": " << str(config.lightPresampling)
+			<< ", \"worldGrid\": " << str(config.worldGrid)
+			<< ", \"gi\": " << str(config.gi)
+			<< ", \"subgroupSpatialReuse\": " << str(config.subgroupSpatialReuse)
+			<< ", \"generationMode\": " << config.generationMode
+			<< ", \"log2InitialLightSamples\": " << config.log2InitialLightSamples
+			<< ", \"reservoirSize\": " << config.reservoirSize
+			<< ", \"halfPrecisionPHat\": " << str(config.halfPrecisionPHat) << " },\n";
+		if (frames.empty()) {
+			out << "\t\t\t\"skipped\": true,\n";
+		}
+		out << "\t\t\t\"average\": { \"cpuMs\": " << cpuSum / frameCount << ", \"processCpuMs\": " << processCpuSum / frameCount
+			<< ", \"waitMs\": " << waitSum / frameCount
+			<< ", \"latencyMs\": " << latencySum / frameCount << ", \"gpuMs\": {";
+		for (std::size_t p = 0; p < gpuSum.size(); ++p) {
+			out << (p ? ", " : " ") << "\"" << gpuSum[p].first << "\": " << gpuSum[p].second / frameCount;
+		}
+		out << " } },\n";
+		if (pHatErrors[c].measured) {
+			const PHatError& error = pHatErrors[c];
+			out << "\t\t\t\"pHatError\": { \"mean\": " << error.mean << ", \"max\": " << error.max
+				<< ", \"samples\": " << error.samples << ", \"zeroed\": " << error.zeroed << " },\n";
+		}
+		if (m_app.m_enablePipelineStats && !frames.empty()) {
+			// summed in doubles, the counters of a few hundred frames overflow 32 bits
+			using Counter = uint32_t shader::PipelineStats::*;
+			const std::pair<const char*, Counter> counters[] = {
+				{ "temporalTested", &shader::PipelineStats::temporalTested },
+				{ "temporalOffscreen", &shader::PipelineStats::temporalOffscreen },
+				{ "temporalPositionRejected", &shader::PipelineStats::temporalPositionRejected },
+				{ "temporalAlbedoRejected", &shader::PipelineStats::temporalAlbedoRejected },
+				{ "temporalNormalRejected", &shader::PipelineStats::temporalNormalRejected },
+				{ "spatialTested", &shader::PipelineStats::spatialTested },
+				{ "spatialMerged", &shader::PipelineStats::spatialMerged },
+				{ "shadowRays", &shader::PipelineStats::shadowRays },
+				{ "shadowRaysOccluded", &shader::PipelineStats::shadowRaysOccluded },
+			};
+			out << "\t\t\t\"pipelineStats\": {";
+			for (const auto& counter : counters) {
+				double sum = 0.0;
+				for (const FrameResult& frame : frames) {
+					sum += frame.pipelineStats.*counter.second;
+				}
+				out << " \"" << counter.first << "\": " << sum / frameCount << ",";
+			}
+			out << " \"mHistogram\": [";
+			for (int i = 0; i < PIPELINE_STATS_M_BINS; ++i) {
+				double sum = 0.0;
+				for (const FrameResult& frame : frames) {
+					sum += frame.pipelineStats.mHistogram[i];
+				}
+				out << (i ? ", " : " ") << sum / frameCount;
+			}
+			out << " ] },\n";
+		}
+		out << "\t\t\t\"frames\": [\n";
+		for (std::size_t f = 0; f < frames.size(); ++f) {
+			out << "\t\t\t\t{ \"cpuMs\": " << frames[f].cpuMs << ", \"processCpuMs\": " << frames[f].processCpuMs
+				<< ", \"waitMs\": " << frames[f].waitMs
+				<< ", \"latencyMs\": " << frames[f].latencyMs << ", \"gpuMs\": {";
+			for (std::size_t p = 0; p < frames[f].gpuMs.size(); ++p) {
+				out << (p ? ", " : " ") << "\"" << frames[f].gpuMs[p].first << "\": " << frames[f].gpuMs[p].second;
+			}
+			out << " } }" << (f + 1 < frames.size() ? "," : "") << "\n";
+		}
+		out << "\t\t\t]\n";
+		out << "\t\t}" << (c + 1 < configs.size() ? "," : "") << "\n";
+	}
+	out << "\t]\n";
+	out << "}\n";
+	std::cout << "Benchmark results written to " << m_output << std::endl;
+	return true;
+}
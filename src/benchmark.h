@@ -0,0 +1,100 @@
+#pragma once
+#include <nvmath/nvmath.h>
+#include "shaderIncludes.h"
+
+#include <string>
+#include <vector>
+
+struct GLFWwindow;
+class App;
+class CameraPath;
+
+// Plays a scripted camera path over the loaded scene under several feature configurations
+// and writes per-frame CPU and process CPU time, per-pass GPU time and memory usage as JSON, optionally with the
+// average pipeline statistics of each configuration.
+class Benchmark {
+public:
+	struct Config {
+		std::string name;
+		bool temporalReuse{ true };
+		bool spatialReuse{ true };
+		bool visibilityTest{ true };
+		bool denoiser{ false };
+		bool adaptiveCandidates{ false };
+		bool lightCulling{ false };
+		bool lightPresampling{ false };
+		bool worldGrid{ false };
+		bool gi{ false };
+		bool subgroupSpatialReuse{ false };
+		int generationMode{ 0 };
+		int log2InitialLightSamples{ 5 };
+		// other sizes recompile the shaders, the configuration is skipped without shaderc
+		uint32_t reservoirSize{ 1 };
+		bool halfPrecisionPHat{ false };
+	};
+
+	Benchmark(App& app, GLFWwindow* window, std::string scene, std::string output);
+
+	void setFrameCount(int frames) {
+		m_frameCount = frames;
+	}
+	void setWarmupFrames(int frames) {
+		m_warmupFrames = frames;
+	}
+	// Counting adds atomics to the restir and spatial reuse passes, their timings include them
+	void setPipelineStats(bool enable) {
+		m_pipelineStats = enable;
+	}
+	// Replaces the built-in orbit, the path is stretched over the measured frames
+	void setCameraPath(const CameraPath* path) {
+		m_cameraPath = path;
+	}
+
+	static std::vector<Config> defaultConfigs();
+
+	// Returns false if the window was closed or the results could not be written
+	bool run(const std::vector<Config>& configs);
+
+	// Renders a reference with referenceFrames of accumulation at the start of the camera path,
+	// then accumulates every configuration from scratch at the same view, capturing the image at
+	// power-of-two frame counts. The output is a directory of PFM files and captures.csv
+	// (config, frame, accumulated GPU time, file), consumed by the restir_error_metrics tool.
+	bool runConvergence(const std::vector<Config>& configs, int referenceFrames);
+
+private:
+	struct FrameResult {
+		double cpuMs;
+		// CPU time of the process, all threads, from render() to the end of the wait for the frame
+		double processCpuMs;
+		// blocked on the frame timeline and the timestamps after render(), and from the submission to the end of that wait
+		double waitMs;
+		double latencyMs;
+		std::vector<std::pair<std::string, double>> gpuMs;
+		shader::PipelineStats pipelineStats;
+	};
+	// fp16 target function error, measured on an extra frame after the timed ones
+	struct PHatError {
+		bool measured{ false };
+		float mean{ 0.0f };
+		float max{ 0.0f };
+		uint32_t samples{ 0 };
+		uint32_t zeroed{ 0 };
+	};
+
+	App& m_app;
+	GLFWwindow* m_window;
+	std::string m_scene;
+	std::string m_output;
+	int m_frameCount = 300;
+	int m_warmupFrames = 30;
+	const CameraPath* m_cameraPath = nullptr;
+	bool m_pipelineStats = false;
+
+	void _applyCamera(float t) const;
+	// Returns false if the configuration cannot be set up in this build
+	bool _applyConfig(const Config& config);
+	// Renders one frame, returns its GPU time in ms, or a negative value if the window was closed
+	double _renderFrame();
+	bool _write(const std::vector<Config>& configs, const std::vector<std::vector<FrameResult>>& results,
+		const std::vector<PHatError>& pHatErrors) const;
+};
@@ -0,0 +1,94 @@
+#include "cameraPath.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "nvh/cameramanipulator.hpp"
+
+bool CameraPath::load(const std::string& filename) {
+	std::ifstream in(filename);
+	if (!in) {
+		std::cerr << "Camera path " << filename << " not found" << std::endl;
+		return false;
+	}
+	m_keyframes.clear();
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		std::istringstream ss(line);
+		Keyframe k;
+		ss >> k.time >> k.eye.x >> k.eye.y >> k.eye.z >> k.center.x >> k.center.y >> k.center.z
+			>> k.up.x >> k.up.y >> k.up.z >> k.fov;
+		if (ss.fail()) {
+			std::cerr << "Camera path " << filename << ": invalid keyframe \"" << line << "\"" << std::endl;
+			m_keyframes.clear();
+			return false;
+		}
+		m_keyframes.push_back(k);
+	}
+	std::stable_sort(m_keyframes.begin(), m_keyframes.end(),
+		[](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+	std::cout << "Camera path " << filename << ": " << m_keyframes.size() << " keyframes, "
+		<< getDuration() << " s" << std::endl;
+	return !m_keyframes.empty();
+}
+
+bool CameraPath::save(const std::string& filename) const {
+	std::ofstream out(filename);
+	if (!out) {
+		std::cerr << "Cannot write camera path " << filename << std::endl;
+		return false;
+	}
+	out << "# time eye.x eye.y eye.z center.x center.y center.z up.x up.y up.z fov\n";
+	out.precision(9);
+	for (const Keyframe& k : m_keyframes) {
+		out << k.time << " " << k.eye.x << " " << k.eye.y << " " << k.eye.z << " "
+			<< k.center.x << " " << k.center.y << " " << k.center.z << " "
+			<< k.up.x << " " << k.up.y << " " << k.up.z << " " << k.fov << "\n";
+	}
+	std::cout << "Camera path written to " << filename << " (" << m_keyframes.size() << " keyframes)" << std::endl;
+	return true;
+}
+
+void CameraPath::record(float time) {
+	Keyframe k;
+	k.time = time;
+	CameraManip.getLookat(k.eye, k.center, k.up);
+	k.fov = CameraManip.getFov();
+	m_keyframes.push_back(k);
+}
+
+CameraPath::Keyframe CameraPath::evaluate(float time) const {
+	if (m_keyframes.empty()) {
+		return {};
+	}
+	if (time <= m_keyframes.front().time) {
+		return m_keyframes.front();
+	}
+	if (time >= m_keyframes.back().time) {
+		return m_keyframes.back();
+	}
+	auto next = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time,
+		[](float t, const Keyframe& k) { return t < k.time; });
+	const Keyframe& a = *(next - 1);
+	const Keyframe& b = *next;
+	float s = (b.time > a.time) ? (time - a.time) / (b.time - a.time) : 0.0f;
+
+	Keyframe k;
+	k.time = time;
+	k.eye = a.eye + (b.eye - a.eye) * s;
+	k.center = a.center + (b.center - a.center) * s;
+	k.up = nvmath::normalize(a.up + (b.up - a.up) * s);
+	k.fov = a.fov + (b.fov - a.fov) * s;
+	return k;
+}
+
+void CameraPath::apply(float time) const {
+	Keyframe k = evaluate(time);
+	CameraManip.setLookat(k.eye, k.center, k.up);
+	CameraManip.setFov(k.fov);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <nvmath/nvmath.h>
+
+#include <string>
+#include <vector>
+
+// Camera keyframes recorded from CameraManip, stored as text (one keyframe per line:
+// time eye.xyz center.xyz up.xyz fov) and replayed by linear interpolation.
+class CameraPath {
+public:
+	struct Keyframe {
+		float         time{ 0.0f };
+		nvmath::vec3f eye;
+		nvmath::vec3f center;
+		nvmath::vec3f up{ 0, 1, 0 };
+		float         fov{ 60.0f };
+	};
+
+	bool load(const std::string& filename);
+	bool save(const std::string& filename) const;
+	void clear() {
+		m_keyframes.clear();
+	}
+
+	// Appends the current CameraManip state at the given time (seconds from the start of the path)
+	void record(float time);
+
+	[[nodiscard]] Keyframe evaluate(float time) const;
+	// Sets CameraManip to the interpolated keyframe
+	void apply(float time) const;
+
+	[[nodiscard]] float getDuration() const {
+		return m_keyframes.empty() ? 0.0f : m_keyframes.back().time;
+	}
+	[[nodiscard]] bool empty() const {
+		return m_keyframes.empty();
+	}
+	[[nodiscard]] std::size_t size() const {
+		return m_keyframes.size();
+	}
+
+private:
+	std::vector<Keyframe> m_keyframes;
+};
@@ -0,0 +1,65 @@
+#include "gpuTimer.h"
+
+#include <cassert>
+
+void GpuTimer::setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, uint32_t maxSections) {
+	m_device = device;
+	m_maxSections = maxSections;
+	m_timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+
+	vk::QueryPoolCreateInfo createInfo{ {}, vk::QueryType::eTimestamp, maxSections * 2 };
+	m_queryPool = m_device.createQueryPool(createInfo);
+}
+
+void GpuTimer::destroy() {
+	m_device.destroy(m_queryPool);
+	m_queryPool = vk::QueryPool();
+}
+
+void GpuTimer::reset(const vk::CommandBuffer& cmdBuf) {
+	cmdBuf.resetQueryPool(m_queryPool, 0, m_maxSections * 2);
+	m_names.clear();
+	m_open = false;
+}
+
+void GpuTimer::begin(const vk::CommandBuffer& cmdBuf, const std::string& name) {
+	assert(!m_open && m_names.size() < m_maxSections);
+	uint32_t index = static_cast<uint32_t>(m_names.size());
+	cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool, index * 2);
+	m_names.push_back(name);
+	m_open = true;
+}
+
+void GpuTimer::end(const vk::CommandBuffer& cmdBuf) {
+	assert(m_open);
+	uint32_t index = static_cast<uint32_t>(m_names.size()) - 1;
+	cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, index * 2 + 1);
+	m_open = false;
+}
+
+void GpuTimer::resolve() {
+	m_times.clear();
+	if (m_names.empty()) {
+		return;
+	}
+	uint32_t queryCount = static_cast<uint32_t>(m_names.size()) * 2;
+	std::vector<uint64_t> timestamps(queryCount);
+	vk::Result result = m_device.getQueryPoolResults(m_queryPool, 0, queryCount,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+		vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+	if (result != vk::Result::eSuccess) {
+		return;
+	}
+	for (std::size_t i = 0; i < m_names.size(); ++i) {
+		double ms = double(timestamps[i * 2 + 1] - timestamps[i * 2]) * m_timestampPeriod / 1000000.0;
+		m_times.emplace_back(m_names[i], ms);
+	}
+}
+
+double GpuTimer::getTotal() const {
+	double total = 0.0;
+	for (const auto& time : m_times) {
+		total += time.second;
+	}
+	return total;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Timestamp-query timer for the passes of one frame.
+// Sections are recorded between reset() and the submission of the frame, and read back with resolve()
+// once that frame has completed on the GPU.
+class GpuTimer {
+public:
+	void setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, uint32_t maxSections);
+	void destroy();
+
+	void reset(const vk::CommandBuffer& cmdBuf);
+	void begin(const vk::CommandBuffer& cmdBuf, const std::string& name);
+	void end(const vk::CommandBuffer& cmdBuf);
+
+	// Blocks until the timestamps of the last recorded frame are available
+	void resolve();
+
+	// Milliseconds per section of the last resolved frame, in recording order
+	[[nodiscard]] const std::vector<std::pair<std::string, double>>& getTimes() const {
+		return m_times;
+	}
+	[[nodiscard]] double getTotal() const;
+
+private:
+	vk::Device m_device;
+	vk::QueryPool m_queryPool;
+	uint32_t m_maxSections = 0;
+	double m_timestampPeriod = 1.0;
+
+	std::vector<std::string> m_names;
+	bool m_open = false;
+	std::vector<std::pair<std::string, double>> m_times;
+};
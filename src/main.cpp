@@ -1,4 +1,7 @@
 #include "app.h"
+#include "benchmark.h"
+#include "startupTrace.h"
+#include "nvh/fileoperations.hpp"
 
 
 std::vector<std::string> defaultSearchPaths;
@@ -24,6 +27,9 @@ bool GenerateWhiteLight = true;
 bool IgnorePointLight = true;
 uint32_t numPointLightGenerates = 100;
 
+//Upper bound of the scratch memory used at once while building BLASes
+vk::DeviceSize blasScratchBudget = 64ull * 1024 * 1024;
+
 std::string environmentalTextureFile = "media/daytime.hdr";
 
 static void onErrorCallback(int error, const char* description)
@@ -34,6 +40,54 @@ static void onErrorCallback(int error, const char* description)
 
 int main(int argc, char** argv)
 {
+	// --scene <gltf>            scene to load instead of the default one
+	// --benchmark <json>        play the benchmark camera path under every configuration and write the results
+	// --frames <count>          measured frames per benchmark configuration
+	// --camera-path <file>      camera path played by the benchmark instead of the orbit
+	// --pipeline-stats          add the average ReSTIR pipeline statistics of each configuration to the benchmark
+	// --convergence <dir>       capture a reference and the accumulation of every configuration at its first view
+	// --reference-frames <n>    accumulated frames of the convergence reference
+	// --startup-trace <json>    write a Chrome trace of the scene loading, CPU zones and GPU submissions
+	std::string benchmarkOutput;
+	std::string convergenceOutput;
+	int referenceFrames = 4096;
+	std::string cameraPathFile;
+	int benchmarkFrames = 300;
+	bool pipelineStats = false;
+	std::string startupTraceOutput;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--scene" && i + 1 < argc) {
+			loadScene = argv[++i];
+		}
+		else if (arg == "--benchmark" && i + 1 < argc) {
+			benchmarkOutput = argv[++i];
+		}
+		else if (arg == "--frames" && i + 1 < argc) {
+			benchmarkFrames = std::stoi(argv[++i]);
+		}
+		else if (arg == "--camera-path" && i + 1 < argc) {
+			cameraPathFile = argv[++i];
+		}
+		else if (arg == "--pipeline-stats") {
+			pipelineStats = true;
+		}
+		else if (arg == "--convergence" && i + 1 < argc) {
+			convergenceOutput = argv[++i];
+		}
+		else if (arg == "--reference-frames" && i + 1 < argc) {
+			referenceFrames = std::stoi(argv[++i]);
+		}
+		else if (arg == "--startup-trace" && i + 1 < argc) {
+			startupTraceOutput = argv[++i];
+			startupTrace.enable();
+		}
+		else {
+			fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+			return -1;
+		}
+	}
+
 	glfwSetErrorCallback(onErrorCallback);
 	if (!glfwInit())
 	{
@@ -62,6 +116,10 @@ int main(int argc, char** argv)
 		NVPSystem::exePath(),
 		NVPSystem::exePath() + std::string(PROJECT_NAME),
 	};
+	if (nvh::findFile(loadScene, defaultSearchPaths).empty()) {
+		fprintf(stderr, "Scene %s not found\n", loadScene.c_str());
+		return -1;
+	}
 	nvvk::Context vkctx;
 	// Requesting Vulkan extensions and layers
 
@@ -87,6 +145,7 @@ int main(int argc, char** argv)
 	contextInfo.addDeviceExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
 	contextInfo.addDeviceExtension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
 	contextInfo.addDeviceExtension(VK_KHR_SHADER_CLOCK_EXTENSION_NAME);
+	contextInfo.addDeviceExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, true);
 	vk::PhysicalDeviceAccelerationStructureFeaturesKHR accelFeature;
 	contextInfo.addDeviceExtension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, false,
 		&accelFeature);
@@ -115,16 +174,44 @@ int main(int argc, char** argv)
 	app.createSwapchain(surface, SAMPLE_WIDTH, SAMPLE_HEIGHT);
 
 	app.createScene(loadScene);
+	if (!startupTraceOutput.empty()) {
+		startupTrace.write(startupTraceOutput);
+	}
 
 	app.setupGlfwCallbacks(window);
 	ImGui_ImplGlfw_InitForVulkan(window, true);
 
 	CameraManip.setLookat(nvmath::vec3f(1, 3, 0), nvmath::vec3f(-5, 0, 0), nvmath::vec3f(0, 1, 0));
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
-		if (app.isMinimized())
-			continue;
-		app.render();
+	int result = 0;
+	if (!benchmarkOutput.empty() || !convergenceOutput.empty()) {
+		bool convergence = !convergenceOutput.empty();
+		Benchmark benchmark(app, window, loadScene, convergence ? convergenceOutput : benchmarkOutput);
+		benchmark.setFrameCount(benchmarkFrames);
+		benchmark.setPipelineStats(pipelineStats);
+		CameraPath cameraPath;
+		if (!cameraPathFile.empty()) {
+			if (cameraPath.load(cameraPathFile)) {
+				benchmark.setCameraPath(&cameraPath);
+			}
+			else {
+				result = -1;
+			}
+		}
+		if (result == 0) {
+			bool succeeded = convergence ? benchmark.runConvergence(Benchmark::defaultConfigs(), referenceFrames)
+				: benchmark.run(Benchmark::defaultConfigs());
+			if (!succeeded) {
+				result = -1;
+			}
+		}
+	}
+	else {
+		while (!glfwWindowShouldClose(window)) {
+			glfwPollEvents();
+			if (app.isMinimized())
+				continue;
+			app.render();
+		}
 	}
 
 	// Cleanup
@@ -136,5 +223,5 @@ int main(int argc, char** argv)
 
 	glfwDestroyWindow(window);
 	glfwTerminate();
-	return 0;
+	return result;
 }
@@ -0,0 +1,60 @@
+#include "memoryStats.h"
+
+#include <cstring>
+
+vk::DeviceSize getImageBytes(const vk::Device& device, const std::vector<vk::Image>& images) {
+	vk::DeviceSize bytes = 0;
+	for (const vk::Image& image : images) {
+		if (image) {
+			bytes += device.getImageMemoryRequirements(image).size;
+		}
+	}
+	return bytes;
+}
+
+vk::DeviceSize getBufferBytes(const vk::Device& device, const std::vector<vk::Buffer>& buffers) {
+	vk::DeviceSize bytes = 0;
+	for (const vk::Buffer& buffer : buffers) {
+		if (buffer) {
+			bytes += device.getBufferMemoryRequirements(buffer).size;
+		}
+	}
+	return bytes;
+}
+
+bool isMemoryBudgetSupported(const vk::PhysicalDevice& physicalDevice) {
+	for (const vk::ExtensionProperties& extension : physicalDevice.enumerateDeviceExtensionProperties()) {
+		if (std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void queryMemoryHeaps(const vk::PhysicalDevice& physicalDevice, MemoryStats& stats) {
+	stats.budgetSupported = isMemoryBudgetSupported(physicalDevice);
+	stats.heaps.clear();
+
+	vk::PhysicalDeviceMemoryProperties properties;
+	vk::PhysicalDeviceMemoryBudgetPropertiesEXT budget;
+	if (stats.budgetSupported) {
+		auto properties2 = physicalDevice.getMemoryProperties2<vk::PhysicalDeviceMemoryProperties2,
+			vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+		properties = properties2.get<vk::PhysicalDeviceMemoryProperties2>().memoryProperties;
+		budget = properties2.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+	}
+	else {
+		properties = physicalDevice.getMemoryProperties();
+	}
+
+	for (uint32_t i = 0; i < properties.memoryHeapCount; ++i) {
+		MemoryStats::Heap heap;
+		heap.size = properties.memoryHeaps[i].size;
+		heap.deviceLocal = bool(properties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+		if (stats.budgetSupported) {
+			heap.budget = budget.heapBudget[i];
+			heap.usage = budget.heapUsage[i];
+		}
+		stats.heaps.push_back(heap);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+// Device memory used by the renderer per category, the utilization of the sub-allocator blocks
+// and the per-heap budget reported by VK_EXT_memory_budget when it is available.
+struct MemoryStats {
+	struct Heap {
+		vk::DeviceSize size{ 0 };
+		vk::DeviceSize budget{ 0 };
+		vk::DeviceSize usage{ 0 };
+		bool deviceLocal{ false };
+	};
+	// Render targets of a frame at a resolution, with the transient ones in separate allocations or aliased
+	struct WorkingSet {
+		vk::Extent2D extent;
+		vk::DeviceSize bytes{ 0 };
+		vk::DeviceSize aliasedBytes{ 0 };
+	};
+
+	vk::DeviceSize geometry{ 0 };
+	vk::DeviceSize textures{ 0 };
+	vk::DeviceSize accelerationStructures{ 0 };
+	vk::DeviceSize gBuffer{ 0 };
+	vk::DeviceSize reservoirs{ 0 };
+	vk::DeviceSize renderTargets{ 0 };
+	// images only used within a frame, sharing one allocation
+	vk::DeviceSize transient{ 0 };
+	vk::DeviceSize transientUnaliased{ 0 };
+
+	vk::DeviceSize allocatedBlockBytes{ 0 };
+	vk::DeviceSize usedBlockBytes{ 0 };
+
+	bool budgetSupported{ false };
+	std::vector<Heap> heaps;
+	std::vector<WorkingSet> workingSets;
+
+	[[nodiscard]] vk::DeviceSize total() const {
+		return geometry + textures + accelerationStructures + gBuffer + reservoirs + renderTargets + transient;
+	}
+};
+
+// Sums of the memory requirements, null handles are skipped
+[[nodiscard]] vk::DeviceSize getImageBytes(const vk::Device& device, const std::vector<vk::Image>& images);
+[[nodiscard]] vk::DeviceSize getBufferBytes(const vk::Device& device, const std::vector<vk::Buffer>& buffers);
+
+[[nodiscard]] bool isMemoryBudgetSupported(const vk::PhysicalDevice& physicalDevice);
+// Fills stats.heaps, with the budget and usage only when VK_EXT_memory_budget is enabled
+void queryMemoryHeaps(const vk::PhysicalDevice& physicalDevice, MemoryStats& stats);
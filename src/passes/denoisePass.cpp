@@ -0,0 +1,82 @@
+#include "denoisePass.h"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/shaders_vk.hpp"
+#include "nvvk/pipeline_vk.hpp"
+#include "nvvk/renderpasses_vk.hpp"
+#include "../shaderReloader.h"
+
+extern std::vector<std::string> defaultSearchPaths;
+
+void DenoisePass::run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, const vk::DescriptorSet& restirDescSet, int iterations) {
+	uint32_t groupsX = (m_size.width + DENOISE_GROUP_SIZE_X - 1) / DENOISE_GROUP_SIZE_X;
+	uint32_t groupsY = (m_size.height + DENOISE_GROUP_SIZE_Y - 1) / DENOISE_GROUP_SIZE_Y;
+
+	cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0,
+		{ sceneDescSet, lightDescSet ,restirDescSet }, {});
+
+	cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_temporalPipeline);
+	cmdBuf.dispatch(groupsX, groupsY, 1);
+
+	// each iteration filters the output of the previous one
+	vk::MemoryBarrier barrier{ vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite };
+	cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_atrousPipeline);
+	for (int i = 0; i < iterations; ++i) {
+		cmdBuf.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eComputeShader,
+			{}, { barrier }, {}, {}
+		);
+		shader::DenoisePushConstant pushC{ i, 1 << i };
+		cmdBuf.pushConstants<shader::DenoisePushConstant>(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pushC);
+		cmdBuf.dispatch(groupsX, groupsY, 1);
+	}
+}
+
+void DenoisePass::setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, uint32_t graphicsQueueIndex, nvvk::Allocator* allocator) {
+	m_device = device;
+	m_graphicsQueueIndex = graphicsQueueIndex;
+	m_physicalDevice = physicalDevice;
+	m_alloc = allocator;
+}
+
+void DenoisePass::createRenderPass(vk::Extent2D outputSize) {
+	m_size = outputSize;
+}
+
+void DenoisePass::createPipeline(const vk::DescriptorSetLayout& sceneDescSetLayout, const vk::DescriptorSetLayout& lightDescSetLayout, const vk::DescriptorSetLayout& restirDescSetLayout) {
+	std::vector<std::string> paths = defaultSearchPaths;
+
+	vk::PushConstantRange push_constants = { vk::ShaderStageFlagBits::eCompute, 0, sizeof(shader::DenoisePushConstant) };
+	vk::PipelineLayoutCreateInfo layout_info;
+	std::vector<vk::DescriptorSetLayout> setlayouts{ sceneDescSetLayout,lightDescSetLayout ,restirDescSetLayout };
+	layout_info.setSetLayouts(setlayouts);
+	layout_info.setPushConstantRangeCount(1);
+	layout_info.setPPushConstantRanges(&push_constants);
+	m_pipelineLayout = m_device.createPipelineLayout(layout_info);
+
+	vk::ComputePipelineCreateInfo computePipelineCreateInfo{ {}, {}, m_pipelineLayout };
+	computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+		m_device, nvh::loadFile(shaderSpv("src/shaders/denoiseTemporal.comp"), true, paths, true),
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	m_temporalPipeline = static_cast<const vk::Pipeline&>(
+		m_device.createComputePipeline({}, computePipelineCreateInfo));
+	m_device.destroy(computePipelineCreateInfo.stage.module);
+
+	computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+		m_device, nvh::loadFile(shaderSpv("src/shaders/denoiseAtrous.comp"), true, paths, true),
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	m_atrousPipeline = static_cast<const vk::Pipeline&>(
+		m_device.createComputePipeline({}, computePipelineCreateInfo));
+	m_device.destroy(computePipelineCreateInfo.stage.module);
+}
+
+void DenoisePass::destroyPipeline() {
+	m_device.destroy(m_temporalPipeline);
+	m_device.destroy(m_atrousPipeline);
+	m_device.destroy(m_pipelineLayout);
+}
+
+void DenoisePass::destroy() {
+	m_device.destroy(m_renderPass);
+	destroyPipeline();
+}
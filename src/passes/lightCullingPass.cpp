@@ -0,0 +1,83 @@
+#include "lightCullingPass.h"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/shaders_vk.hpp"
+#include "nvvk/pipeline_vk.hpp"
+#include "../shaderReloader.h"
+
+extern std::vector<std::string> defaultSearchPaths;
+
+void LightCullingPass::run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, const vk::DescriptorSet& restirDescSet,
+	const vk::Buffer& cellCountBuffer, const vk::Buffer& cellEntryBuffer, uint32_t cellCount, uint32_t pointLightCount) {
+	cmdBuf.fillBuffer(cellCountBuffer, 0, VK_WHOLE_SIZE, 0);
+	// the keys and weights of the entries are accumulated while binning
+	cmdBuf.fillBuffer(cellEntryBuffer, 0, VK_WHOLE_SIZE, 0);
+	vk::MemoryBarrier clearBarrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite };
+	cmdBuf.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer,
+		vk::PipelineStageFlagBits::eComputeShader,
+		{}, { clearBarrier }, {}, {}
+	);
+
+	cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0,
+		{ sceneDescSet, lightDescSet, restirDescSet }, {});
+
+	vk::MemoryBarrier binBarrier{ vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite };
+	cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_binPipeline);
+	// the second dispatch writes the lights that won the entries of the overflowing cells
+	for (int resolve = 0; resolve < 2; ++resolve) {
+		cmdBuf.pushConstants<int>(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, resolve);
+		cmdBuf.dispatch((pointLightCount + LIGHT_CULLING_GROUP_SIZE - 1) / LIGHT_CULLING_GROUP_SIZE, 1, 1);
+		cmdBuf.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eComputeShader,
+			{}, { binBarrier }, {}, {}
+		);
+	}
+
+	cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_buildPipeline);
+	cmdBuf.dispatch((cellCount + LIGHT_CULLING_GROUP_SIZE - 1) / LIGHT_CULLING_GROUP_SIZE, 1, 1);
+}
+
+void LightCullingPass::setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, uint32_t graphicsQueueIndex, nvvk::Allocator* allocator) {
+	m_device = device;
+	m_graphicsQueueIndex = graphicsQueueIndex;
+	m_physicalDevice = physicalDevice;
+	m_alloc = allocator;
+}
+
+void LightCullingPass::createPipeline(const vk::DescriptorSetLayout& sceneDescSetLayout, const vk::DescriptorSetLayout& lightDescSetLayout, const vk::DescriptorSetLayout& restirDescSetLayout) {
+	std::vector<std::string> paths = defaultSearchPaths;
+
+	vk::PipelineLayoutCreateInfo layout_info;
+	std::vector<vk::DescriptorSetLayout> setlayouts{ sceneDescSetLayout, lightDescSetLayout, restirDescSetLayout };
+	layout_info.setSetLayouts(setlayouts);
+	vk::PushConstantRange push_constants = { vk::ShaderStageFlagBits::eCompute, 0, sizeof(int) };
+	layout_info.setPushConstantRangeCount(1);
+	layout_info.setPPushConstantRanges(&push_constants);
+	m_pipelineLayout = m_device.createPipelineLayout(layout_info);
+
+	vk::ComputePipelineCreateInfo computePipelineCreateInfo{ {}, {}, m_pipelineLayout };
+	computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+		m_device, nvh::loadFile(shaderSpv("src/shaders/lightCullingBin.comp"), true, paths, true),
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	m_binPipeline = static_cast<const vk::Pipeline&>(
+		m_device.createComputePipeline({}, computePipelineCreateInfo));
+	m_device.destroy(computePipelineCreateInfo.stage.module);
+
+	computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+		m_device, nvh::loadFile(shaderSpv("src/shaders/lightCullingBuild.comp"), true, paths, true),
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	m_buildPipeline = static_cast<const vk::Pipeline&>(
+		m_device.createComputePipeline({}, computePipelineCreateInfo));
+	m_device.destroy(computePipelineCreateInfo.stage.module);
+}
+
+void LightCullingPass::destroyPipeline() {
+	m_device.destroy(m_binPipeline);
+	m_device.destroy(m_buildPipeline);
+	m_device.destroy(m_pipelineLayout);
+}
+
+void LightCullingPass::destroy() {
+	destroyPipeline();
+}
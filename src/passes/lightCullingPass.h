@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "../util.h"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/shaders_vk.hpp"
+
+
+// Bins the point lights into screen-space froxels by their influence radius and builds
+// an alias table per froxel, read by the candidate generation of the restir pass.
+class LightCullingPass {
+public:
+	void setup(const vk::Device& device, const vk::PhysicalDevice&, uint32_t graphicsQueueIndex, nvvk::Allocator* allocator);
+
+	void createPipeline(const vk::DescriptorSetLayout& sceneDescSetLayout, const vk::DescriptorSetLayout& lightDescSetLayout, const vk::DescriptorSetLayout& restirDescSetLayout);
+
+	// cellCountBuffer and cellEntryBuffer are cleared here, cellCount is the number of froxels at the current render size
+	void run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, const vk::DescriptorSet& restirDescSet,
+		const vk::Buffer& cellCountBuffer, const vk::Buffer& cellEntryBuffer, uint32_t cellCount, uint32_t pointLightCount);
+
+	// Releases what createPipeline created, so that the pipeline can be rebuilt after a shader reload
+	void destroyPipeline();
+	void destroy();
+
+private:
+	vk::Device m_device;
+	vk::PhysicalDevice m_physicalDevice;
+	uint32_t m_graphicsQueueIndex;
+	nvvk::Allocator* m_alloc;
+
+	vk::PipelineLayout m_pipelineLayout;
+	vk::Pipeline     m_binPipeline;
+	vk::Pipeline     m_buildPipeline;
+};
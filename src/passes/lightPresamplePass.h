@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "../util.h"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/shaders_vk.hpp"
+
+
+// Fills the presampled light tiles from the global alias table, once per frame before the restir pass.
+class LightPresamplePass {
+public:
+	void setup(const vk::Device& device, const vk::PhysicalDevice&, uint32_t graphicsQueueIndex, nvvk::Allocator* allocator);
+
+	void createPipeline(const vk::DescriptorSetLayout& sceneDescSetLayout, const vk::DescriptorSetLayout& lightDescSetLayout);
+
+	void run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet);
+
+	// Releases what createPipeline created, so that the pipeline can be rebuilt after a shader reload
+	void destroyPipeline();
+	void destroy();
+
+private:
+	vk::Device m_device;
+	vk::PhysicalDevice m_physicalDevice;
+	uint32_t m_graphicsQueueIndex;
+	nvvk::Allocator* m_alloc;
+
+	vk::PipelineLayout m_pipelineLayout;
+	vk::Pipeline     m_pipeline;
+};
@@ -3,15 +3,11 @@
 #include "nvvk/shaders_vk.hpp"
 #include "nvvk/pipeline_vk.hpp"
 #include "nvvk/renderpasses_vk.hpp"
+#include "../shaderReloader.h"
 
 extern std::vector<std::string> defaultSearchPaths;
 
-void RestirPass::run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& uniformDescSet, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, const vk::DescriptorSet& restirDescSet) {
-	cmdBuf.pipelineBarrier(
-		vk::PipelineStageFlagBits::eAllCommands,
-		vk::PipelineStageFlagBits::eAllCommands,
-		{}, {}, {}, {}
-	);
+void RestirPass::run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& uniformDescSet, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, const vk::DescriptorSet& restirDescSet, int generationMode) {
 	cmdBuf.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, m_pipeline);
 	cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, m_pipelineLayout, 0,
 		{ uniformDescSet, sceneDescSet, lightDescSet,restirDescSet }, {});
@@ -28,9 +24,19 @@ void RestirPass::run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& u
 		Stride{sbtAddress + 3u * groupSize, groupStride, groupSize * 1},  // hit
 		Stride{0u, 0u, 0u} };                                              // callable
 
+	// the raygen shader remaps the launch so that the generating pixels form contiguous halves/quadrants
+	vk::Extent2D launchSize = m_size;
+	if (generationMode == GENERATION_MODE_CHECKERBOARD) {
+		launchSize.width = (m_size.width + 1) / 2 * 2;
+	}
+	else if (generationMode == GENERATION_MODE_QUARTER) {
+		launchSize.width = (m_size.width + 1) / 2 * 2;
+		launchSize.height = (m_size.height + 1) / 2 * 2;
+	}
+
 	cmdBuf.traceRaysKHR(&strideAddresses[0], &strideAddresses[1], &strideAddresses[2],
 		&strideAddresses[3],  //
-		m_size.width, m_size.height,
+		launchSize.width, launchSize.height,
 		1);  //
 
 }
@@ -54,15 +60,15 @@ void RestirPass::createPipeline(const vk::DescriptorSetLayout& uniformDescSetLay
 	std::vector<std::string> paths = defaultSearchPaths;
 	vk::ShaderModule raygenSM =
 		nvvk::createShaderModule(m_device,  //
-			nvh::loadFile("src/shaders/restir.rgen.spv", true, paths, true));
+			nvh::loadFile(shaderSpv("src/shaders/restir.rgen"), true, paths, true));
 	vk::ShaderModule missSM =
 		nvvk::createShaderModule(m_device,  //
-			nvh::loadFile("src/shaders/restir.rmiss.spv", true, paths, true));
+			nvh::loadFile(shaderSpv("src/shaders/restir.rmiss"), true, paths, true));
 
 	// The second miss shader is invoked when a shadow ray misses the geometry. It
 	// simply indicates that no occlusion has been found
 	vk::ShaderModule shadowmissSM = nvvk::createShaderModule(
-		m_device, nvh::loadFile("src/shaders/restirShadow.rmiss.spv", true, paths, true));
+		m_device, nvh::loadFile(shaderSpv("src/shaders/restirShadow.rmiss"), true, paths, true));
 
 	std::vector<vk::PipelineShaderStageCreateInfo> stages;
 	// Raygen
@@ -86,7 +92,7 @@ void RestirPass::createPipeline(const vk::DescriptorSetLayout& uniformDescSetLay
 
 	vk::ShaderModule chitSM =
 		nvvk::createShaderModule(m_device,  //
-			nvh::loadFile("src/shaders/restir.rchit.spv", true, paths, true));
+			nvh::loadFile(shaderSpv("src/shaders/restir.rchit"), true, paths, true));
 
 	vk::RayTracingShaderGroupCreateInfoKHR hg{ vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup,
 											VK_SHADER_UNUSED_KHR, VK_SHADER_UNUSED_KHR,
@@ -156,10 +162,14 @@ void RestirPass::_createShaderBindingTable()
 	m_alloc->finalizeAndReleaseStaging();
 }
 
-void RestirPass::destroy() {
-	m_device.destroy(m_renderPass);
+void RestirPass::destroyPipeline() {
 	m_device.destroy(m_pipeline);
 	m_device.destroy(m_pipelineLayout);
-
 	m_alloc->destroy(m_SBTBuffer);
+	m_rtShaderGroups.clear();
+}
+
+void RestirPass::destroy() {
+	m_device.destroy(m_renderPass);
+	destroyPipeline();
 }
\ No newline at end of file
@@ -18,11 +18,17 @@ public:
 
 	void createDescriptorSet() {};
 	void createRenderPass(vk::Extent2D outputSize);
+	// Sub-rectangle of the render targets processed by run(), up to the size given to createRenderPass
+	void setRenderSize(vk::Extent2D renderSize) {
+		m_size = renderSize;
+	}
 	void createPipeline(const vk::DescriptorSetLayout& uniformDescSetLayout, const vk::DescriptorSetLayout& sceneDescSetLayout, const vk::DescriptorSetLayout& lightDescSetLayout, const vk::DescriptorSetLayout& restirDescSetLayout);
 
 	bool uiSetup() {};
-	void run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& uniformDescSet, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet,  const vk::DescriptorSet& restirDescSet);
+	void run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& uniformDescSet, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet,  const vk::DescriptorSet& restirDescSet, int generationMode);
 
+	// Releases what createPipeline created, so that the pipeline can be rebuilt after a shader reload
+	void destroyPipeline();
 	void destroy();
 
 private:
@@ -0,0 +1,58 @@
+#include "shadePass.h"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/shaders_vk.hpp"
+#include "nvvk/pipeline_vk.hpp"
+#include "../shaderReloader.h"
+
+extern std::vector<std::string> defaultSearchPaths;
+
+void ShadePass::run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, const vk::DescriptorSet& restirDescSet, const shader::PushConstant& pushC) {
+	cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+	cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0,
+		{ sceneDescSet, lightDescSet ,restirDescSet }, {});
+	cmdBuf.pushConstants<shader::PushConstant>(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, pushC);
+	cmdBuf.dispatch(
+		(m_size.width + SHADE_GROUP_SIZE_X - 1) / SHADE_GROUP_SIZE_X,
+		(m_size.height + SHADE_GROUP_SIZE_Y - 1) / SHADE_GROUP_SIZE_Y,
+		1);
+}
+
+void ShadePass::setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, uint32_t graphicsQueueIndex, nvvk::Allocator* allocator) {
+	m_device = device;
+	m_graphicsQueueIndex = graphicsQueueIndex;
+	m_physicalDevice = physicalDevice;
+	m_alloc = allocator;
+}
+
+void ShadePass::createRenderPass(vk::Extent2D outputSize) {
+	m_size = outputSize;
+}
+
+void ShadePass::createPipeline(const vk::DescriptorSetLayout& sceneDescSetLayout, const vk::DescriptorSetLayout& lightDescSetLayout, const vk::DescriptorSetLayout& restirDescSetLayout) {
+	std::vector<std::string> paths = defaultSearchPaths;
+
+	vk::PushConstantRange push_constants = { vk::ShaderStageFlagBits::eCompute, 0, sizeof(shader::PushConstant) };
+	vk::PipelineLayoutCreateInfo layout_info;
+	std::vector<vk::DescriptorSetLayout> setlayouts{ sceneDescSetLayout,lightDescSetLayout ,restirDescSetLayout };
+	layout_info.setSetLayouts(setlayouts);
+	layout_info.setPushConstantRangeCount(1);
+	layout_info.setPPushConstantRanges(&push_constants);
+	m_pipelineLayout = m_device.createPipelineLayout(layout_info);
+
+	vk::ComputePipelineCreateInfo computePipelineCreateInfo{ {}, {}, m_pipelineLayout };
+	computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+		m_device, nvh::loadFile(shaderSpv("src/shaders/shade.comp"), true, paths, true),
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	m_pipeline = static_cast<const vk::Pipeline&>(
+		m_device.createComputePipeline({}, computePipelineCreateInfo));
+	m_device.destroy(computePipelineCreateInfo.stage.module);
+}
+
+void ShadePass::destroyPipeline() {
+	m_device.destroy(m_pipeline);
+	m_device.destroy(m_pipelineLayout);
+}
+
+void ShadePass::destroy() {
+	destroyPipeline();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "../util.h"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/shaders_vk.hpp"
+
+
+// Resolves the final reservoirs into the HDR radiance image and the accumulation image.
+class ShadePass {
+public:
+	void setup(const vk::Device& device, const vk::PhysicalDevice&, uint32_t graphicsQueueIndex, nvvk::Allocator* allocator);
+
+	void createRenderPass(vk::Extent2D outputSize);
+	// Sub-rectangle of the render targets processed by run(), up to the size given to createRenderPass
+	void setRenderSize(vk::Extent2D renderSize) {
+		m_size = renderSize;
+	}
+	void createPipeline(const vk::DescriptorSetLayout& sceneDescSetLayout, const vk::DescriptorSetLayout& lightDescSetLayout, const vk::DescriptorSetLayout& restirDescSetLayout);
+
+	void run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, const vk::DescriptorSet& restirDescSet, const shader::PushConstant& pushC);
+
+	// Releases what createPipeline created, so that the pipeline can be rebuilt after a shader reload
+	void destroyPipeline();
+	void destroy();
+
+private:
+	vk::Device m_device;
+	vk::PhysicalDevice m_physicalDevice;
+	uint32_t m_graphicsQueueIndex;
+	nvvk::Allocator* m_alloc;
+	vk::Extent2D m_size;
+
+	vk::PipelineLayout m_pipelineLayout;
+	vk::Pipeline     m_pipeline;
+};
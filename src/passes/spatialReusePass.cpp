@@ -3,16 +3,11 @@
 #include "nvvk/shaders_vk.hpp"
 #include "nvvk/pipeline_vk.hpp"
 #include "nvvk/renderpasses_vk.hpp"
+#include "../shaderReloader.h"
 
 extern std::vector<std::string> defaultSearchPaths;
 
 void SpatialReusePass::run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, const vk::DescriptorSet& restirDescSet) {
-	cmdBuf.pipelineBarrier(
-		vk::PipelineStageFlagBits::eComputeShader,
-		vk::PipelineStageFlagBits::eComputeShader,
-		{}, {}, {}, {}
-	);
-
 	cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
 	cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0,
 		{ sceneDescSet, lightDescSet ,restirDescSet }, {});
@@ -24,6 +19,14 @@ void SpatialReusePass::setup(const vk::Device& device, const vk::PhysicalDevice&
 	m_graphicsQueueIndex = graphicsQueueIndex;
 	m_physicalDevice = physicalDevice;
 	m_alloc = allocator;
+
+	auto properties = m_physicalDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+	const auto& subgroup = properties.get<vk::PhysicalDeviceSubgroupProperties>();
+	vk::SubgroupFeatureFlags required = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eVote
+		| vk::SubgroupFeatureFlagBits::eShuffle;
+	m_subgroupSharing = (subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute)
+		&& (subgroup.supportedOperations & required) == required
+		&& subgroup.subgroupSize >= SUBGROUP_SPATIAL_REUSE_SHARING;
 }
 
 void SpatialReusePass::createRenderPass(vk::Extent2D outputSize) {
@@ -42,16 +45,19 @@ void SpatialReusePass::createPipeline(const vk::DescriptorSetLayout& sceneDescSe
 	vk::ComputePipelineCreateInfo computePipelineCreateInfo{ {}, {}, m_pipelineLayout };
 
 	computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
-		m_device, nvh::loadFile("src/shaders/spatialReuse.comp.spv", true, defaultSearchPaths, true),
+		m_device, nvh::loadFile(shaderSpv("src/shaders/spatialReuse.comp"), true, defaultSearchPaths, true),
 		VK_SHADER_STAGE_COMPUTE_BIT);
 	m_pipeline = static_cast<const vk::Pipeline&>(
 		m_device.createComputePipeline({}, computePipelineCreateInfo));
 	m_device.destroy(computePipelineCreateInfo.stage.module);
 }
 
-void SpatialReusePass::destroy() {
-	m_device.destroy(m_renderPass);
+void SpatialReusePass::destroyPipeline() {
 	m_device.destroy(m_pipeline);
 	m_device.destroy(m_pipelineLayout);
+}
 
+void SpatialReusePass::destroy() {
+	m_device.destroy(m_renderPass);
+	destroyPipeline();
 }
\ No newline at end of file
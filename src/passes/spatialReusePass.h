@@ -18,11 +18,21 @@ public:
 
 	void createDescriptorSet() {};
 	void createRenderPass(vk::Extent2D outputSize);
+	// Sub-rectangle of the render targets processed by run(), up to the size given to createRenderPass
+	void setRenderSize(vk::Extent2D renderSize) {
+		m_size = renderSize;
+	}
 	void createPipeline(const vk::DescriptorSetLayout& sceneDescSetLayout, const vk::DescriptorSetLayout& lightDescSetLayout,const vk::DescriptorSetLayout& restirDescSetLayout);
 
 	bool uiSetup() {};
+	// The subgroup variant of spatialReuse.comp shuffles the neighbors between the lanes of a compute subgroup
+	bool supportsSubgroupSharing() const {
+		return m_subgroupSharing;
+	}
 	void run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, const vk::DescriptorSet& restirDescSet);
 
+	// Releases what createPipeline created, so that the pipeline can be rebuilt after a shader reload
+	void destroyPipeline();
 	void destroy();
 
 private:
@@ -31,6 +41,7 @@ private:
 	uint32_t m_graphicsQueueIndex;
 	nvvk::Allocator* m_alloc;
 	vk::Extent2D m_size;
+	bool m_subgroupSharing = false;
 
 	vk::PipelineLayout m_pipelineLayout;
 	vk::Pipeline     m_pipeline;
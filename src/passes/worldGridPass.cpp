@@ -0,0 +1,47 @@
+#include "worldGridPass.h"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/shaders_vk.hpp"
+#include "nvvk/pipeline_vk.hpp"
+#include "../shaderReloader.h"
+
+extern std::vector<std::string> defaultSearchPaths;
+
+void WorldGridPass::run(const vk::CommandBuffer& cmdBuf, const vk::DescriptorSet& sceneDescSet, const vk::DescriptorSet& lightDescSet, uint32_t reservoirCount) {
+	cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+	cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0,
+		{ sceneDescSet, lightDescSet }, {});
+	cmdBuf.dispatch((reservoirCount + WORLD_GRID_GROUP_SIZE - 1) / WORLD_GRID_GROUP_SIZE, 1, 1);
+}
+
+void WorldGridPass::setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice, uint32_t graphicsQueueIndex, nvvk::Allocator* allocator) {
+	m_device = device;
+	m_graphicsQueueIndex = graphicsQueueIndex;
+	m_physicalDevice = physicalDevice;
+	m_alloc = allocator;
+}
+
+void WorldGridPass::createPipeline(const vk::DescriptorSetLayout& sceneDescSetLayout, const vk::DescriptorSetLayout& lightDescSetLayout) {
+	std::vector<std::string> paths = defaultSearchPaths;
+
+	vk::PipelineLayoutCreateInfo layout_info;
+	std::vector<vk::DescriptorSetLayout> setlayouts{ sceneDescSetLayout, lightDescSetLayout };
+	layout_info.setSetLayouts(setlayouts);
+	m_pipelineLayout = m_device.createPipelineLayout(layout_info);
+
+	vk::ComputePipelineCreateInfo computePipelineCreateInfo{ {}, {}, m_pipelineLayout };
+	computePipelineCreateInfo.stage = nvvk::createShaderStageInfo(
+		m_device, nvh::loadFile(shaderSpv("src/shaders/worldGrid.comp"), true, paths, true),
+		VK_SHADER_STAGE_COMPUTE_BIT);
+	m_pipeline = static_cast<const vk::Pipeline&>(
+		m_device.createComputePipeline({}, computePipelineCreateInfo));
+	m_device.destroy(computePipelineCreateInfo.stage.module);
+}
+
+void WorldGridPass::destroyPipeline() {
+	m_device.destroy(m_pipeline);
+	m_device.destroy(m_pipelineLayout);
+}
+
+void WorldGridPass::destroy() {
+	destroyPipeline();
+}
@@ -0,0 +1,50 @@
+#include "pfm.h"
+
+#include <fstream>
+#include <iostream>
+
+bool writePfm(const std::string& filename, uint32_t width, uint32_t height, uint32_t channels, const float* pixels) {
+	std::ofstream out(filename, std::ios::binary);
+	if (!out) {
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+	out << "PF\n" << width << " " << height << "\n-1.0\n";
+	std::vector<float> row(std::size_t(width) * 3);
+	for (uint32_t y = 0; y < height; ++y) {
+		const float* src = pixels + std::size_t(height - 1 - y) * width * channels;
+		for (uint32_t x = 0; x < width; ++x) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				row[std::size_t(x) * 3 + c] = src[std::size_t(x) * channels + c];
+			}
+		}
+		out.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+	}
+	return bool(out);
+}
+
+bool readPfm(const std::string& filename, PfmImage& image) {
+	std::ifstream in(filename, std::ios::binary);
+	if (!in) {
+		std::cerr << "Cannot read " << filename << std::endl;
+		return false;
+	}
+	std::string magic;
+	float scale = 0.0f;
+	in >> magic >> image.width >> image.height >> scale;
+	in.get();
+	if (magic != "PF" || scale >= 0.0f || !in) {
+		std::cerr << filename << " is not a little endian RGB PFM" << std::endl;
+		return false;
+	}
+	std::size_t rowSize = std::size_t(image.width) * 3;
+	image.rgb.resize(rowSize * image.height);
+	for (uint32_t y = 0; y < image.height; ++y) {
+		in.read(reinterpret_cast<char*>(image.rgb.data() + rowSize * (image.height - 1 - y)), rowSize * sizeof(float));
+	}
+	if (!in) {
+		std::cerr << filename << " is truncated" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Portable float map (PF, little endian RGB) reading and writing.
+// In memory images are stored top to bottom, the file stores them bottom to top.
+struct PfmImage {
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	std::vector<float> rgb;
+};
+
+// pixels holds width * height * channels floats (channels >= 3), the first three are written
+bool writePfm(const std::string& filename, uint32_t width, uint32_t height, uint32_t channels, const float* pixels);
+bool readPfm(const std::string& filename, PfmImage& image);
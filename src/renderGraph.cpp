@@ -0,0 +1,181 @@
+#include "renderGraph.h"
+#include "gpuTimer.h"
+
+#include <algorithm>
+
+namespace {
+const vk::AccessFlags WriteAccess = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite
+	| vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite
+	| vk::AccessFlagBits::eHostWrite | vk::AccessFlagBits::eMemoryWrite | vk::AccessFlagBits::eAccelerationStructureWriteKHR;
+
+template <typename Handle>
+uint64_t handleKey(Handle handle) {
+	return uint64_t(static_cast<typename Handle::CType>(handle));
+}
+}  // namespace
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(vk::Buffer buffer, vk::AccessFlags access) {
+	m_graph._addUse(m_pass, handleKey(buffer), nullptr, access, vk::ImageLayout::eUndefined);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(vk::Buffer buffer, vk::AccessFlags access) {
+	m_graph._addUse(m_pass, handleKey(buffer), nullptr, access, vk::ImageLayout::eUndefined);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::readWrite(vk::Buffer buffer) {
+	return write(buffer, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(vk::Image image, vk::ImageLayout layout, vk::AccessFlags access) {
+	m_graph._addUse(m_pass, handleKey(image), image, access, layout);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(vk::Image image, vk::ImageLayout layout, vk::AccessFlags access) {
+	m_graph._addUse(m_pass, handleKey(image), image, access, layout);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::readWrite(vk::Image image, vk::ImageLayout layout) {
+	return write(image, layout, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(const std::string& name, vk::PipelineStageFlags stages, RecordFunc record, bool timed) {
+	m_passes.push_back({ name, stages, std::move(record), timed, {} });
+	return PassBuilder(*this, m_passes.size() - 1);
+}
+
+void RenderGraph::_addUse(std::size_t pass, uint64_t handle, vk::Image image, vk::AccessFlags access, vk::ImageLayout layout) {
+	std::vector<Use>& uses = m_passes[pass].uses;
+	// a resource used several ways by a pass is synchronized once for all of them
+	auto it = std::find_if(uses.begin(), uses.end(), [&](const Use& use) { return use.handle == handle && bool(use.image) == bool(image); });
+	if (it != uses.end()) {
+		it->access |= access;
+		return;
+	}
+	uses.push_back({ handle, image, access, layout });
+}
+
+void RenderGraph::_barrier(const vk::CommandBuffer& cmdBuf, const Pass& pass) {
+	vk::PipelineStageFlags srcStages;
+	vk::PipelineStageFlags dstStages;
+	vk::MemoryBarrier memoryBarrier;
+	std::vector<vk::ImageMemoryBarrier> imageBarriers;
+
+	for (const Use& use : pass.uses) {
+		State& state = (use.image ? m_imageStates : m_bufferStates)[use.handle];
+		bool writes = bool(use.access & WriteAccess);
+
+		vk::PipelineStageFlags previous = state.writeStages | state.readStages;
+		vk::AccessFlags previousWrites = state.writeAccess;
+		auto transient = use.image ? m_transientAliases.find(use.handle) : m_transientAliases.end();
+		bool discard = transient != m_transientAliases.end() && m_discarded.insert(use.handle).second;
+		if (discard) {
+			// another image may have been in the memory since the last use of this one
+			for (uint64_t alias : transient->second) {
+				const State& aliasState = m_imageStates[alias];
+				previous |= aliasState.writeStages | aliasState.readStages;
+				previousWrites |= aliasState.writeAccess;
+			}
+		}
+
+		if (discard || (use.image && state.layout != vk::ImageLayout::eUndefined && state.layout != use.layout)) {
+			vk::ImageMemoryBarrier barrier;
+			barrier.setSrcAccessMask(previousWrites);
+			barrier.setDstAccessMask(use.access);
+			barrier.setOldLayout(discard ? vk::ImageLayout::eUndefined : state.layout);
+			barrier.setNewLayout(use.layout);
+			barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+			barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+			barrier.setImage(use.image);
+			barrier.setSubresourceRange({ vk::ImageAspectFlagBits::eColor, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS });
+			imageBarriers.push_back(barrier);
+			srcStages |= previous ? previous : vk::PipelineStageFlagBits::eTopOfPipe;
+			dstStages |= pass.stages;
+			// the transition is a write the following uses wait for
+			state.writeStages = pass.stages;
+			state.writeAccess = use.access & WriteAccess;
+			state.readStages = writes ? vk::PipelineStageFlags() : pass.stages;
+			state.layout = use.layout;
+			continue;
+		}
+		state.layout = use.layout;
+
+		if (writes) {
+			// write after write, and write after read for which waiting for the readers is enough
+			if (state.writeStages) {
+				srcStages |= state.writeStages;
+				memoryBarrier.srcAccessMask |= state.writeAccess;
+				memoryBarrier.dstAccessMask |= use.access;
+				dstStages |= pass.stages;
+			}
+			if (state.readStages) {
+				srcStages |= state.readStages;
+				dstStages |= pass.stages;
+			}
+			state.writeStages = pass.stages;
+			state.writeAccess = use.access & WriteAccess;
+			state.readStages = vk::PipelineStageFlags();
+		}
+		else {
+			// read after write, unless these stages already waited for the write
+			if (state.writeStages && (pass.stages & ~state.readStages)) {
+				srcStages |= state.writeStages;
+				memoryBarrier.srcAccessMask |= state.writeAccess;
+				memoryBarrier.dstAccessMask |= use.access;
+				dstStages |= pass.stages;
+			}
+			state.readStages |= pass.stages;
+		}
+	}
+
+	if (!srcStages) {
+		return;
+	}
+	std::vector<vk::MemoryBarrier> memoryBarriers;
+	if (memoryBarrier.srcAccessMask) {
+		memoryBarriers.push_back(memoryBarrier);
+	}
+	cmdBuf.pipelineBarrier(srcStages, dstStages, {}, memoryBarriers, {}, imageBarriers);
+	++m_barrierCount;
+}
+
+void RenderGraph::execute(const vk::CommandBuffer& cmdBuf, GpuTimer* timer) {
+	m_barrierCount = 0;
+	m_discarded.clear();
+	for (const Pass& pass : m_passes) {
+		_barrier(cmdBuf, pass);
+		if (!pass.record) {
+			continue;
+		}
+		bool timed = pass.timed && timer != nullptr;
+		if (timed) {
+			timer->begin(cmdBuf, pass.name);
+		}
+		pass.record(cmdBuf);
+		if (timed) {
+			timer->end(cmdBuf);
+		}
+	}
+	m_passes.clear();
+}
+
+void RenderGraph::setTransient(vk::Image image, const std::vector<vk::Image>& aliases) {
+	std::vector<uint64_t>& keys = m_transientAliases[handleKey(image)];
+	keys.clear();
+	for (const vk::Image& alias : aliases) {
+		keys.push_back(handleKey(alias));
+	}
+}
+
+void RenderGraph::reset() {
+	m_imageStates.clear();
+	m_bufferStates.clear();
+	m_transientAliases.clear();
+}
+
+void RenderGraph::forget(vk::Buffer buffer) {
+	m_bufferStates.erase(handleKey(buffer));
+}
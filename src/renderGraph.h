@@ -0,0 +1,96 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class GpuTimer;
+
+// Records the passes of a frame in order and places the barriers between them from the images and
+// buffers each pass declares it reads and writes. A barrier is only emitted for an actual hazard
+// (read after write, write after read or write after write) or a layout change, with the stages and
+// accesses of the passes involved, so independent passes can overlap on the GPU.
+// Barriers between the dispatches of one pass stay in the pass.
+//
+// The state of the resources is kept from one frame to the next, the first passes of a frame wait for
+// the last users of the previous one. Images start in the layout of their first declared use.
+class RenderGraph {
+public:
+	using RecordFunc = std::function<void(const vk::CommandBuffer&)>;
+
+	class PassBuilder {
+	public:
+		PassBuilder& read(vk::Buffer buffer, vk::AccessFlags access = vk::AccessFlagBits::eShaderRead);
+		PassBuilder& write(vk::Buffer buffer, vk::AccessFlags access = vk::AccessFlagBits::eShaderWrite);
+		PassBuilder& readWrite(vk::Buffer buffer);
+		PassBuilder& read(vk::Image image, vk::ImageLayout layout = vk::ImageLayout::eGeneral,
+			vk::AccessFlags access = vk::AccessFlagBits::eShaderRead);
+		PassBuilder& write(vk::Image image, vk::ImageLayout layout = vk::ImageLayout::eGeneral,
+			vk::AccessFlags access = vk::AccessFlagBits::eShaderWrite);
+		PassBuilder& readWrite(vk::Image image, vk::ImageLayout layout = vk::ImageLayout::eGeneral);
+
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graph, std::size_t pass) : m_graph(graph), m_pass(pass) {}
+		RenderGraph& m_graph;
+		std::size_t m_pass;
+	};
+
+	// stages: every stage the pass runs, including the transfers it records.
+	// A pass without a record function only waits for its inputs, e.g. for work recorded later in another command buffer.
+	PassBuilder addPass(const std::string& name, vk::PipelineStageFlags stages, RecordFunc record = nullptr, bool timed = true);
+
+	// Records the added passes with their barriers, timing the timed ones, then removes them
+	void execute(const vk::CommandBuffer& cmdBuf, GpuTimer* timer = nullptr);
+
+	// The image shares memory with the aliases. Its content is dropped at its first use of each frame,
+	// which waits for all the previous users of the memory.
+	void setTransient(vk::Image image, const std::vector<vk::Image>& aliases);
+
+	// Forgets the resource states and the transient images, for when the resources were recreated
+	void reset();
+	// Forgets the state of a destroyed buffer, a buffer created later may get the same handle
+	void forget(vk::Buffer buffer);
+
+	// Barriers emitted by the last execute(), for the UI
+	[[nodiscard]] uint32_t getBarrierCount() const {
+		return m_barrierCount;
+	}
+
+private:
+	struct Use {
+		uint64_t handle;
+		vk::Image image;
+		vk::AccessFlags access;
+		vk::ImageLayout layout;
+	};
+	struct Pass {
+		std::string name;
+		vk::PipelineStageFlags stages;
+		RecordFunc record;
+		bool timed;
+		std::vector<Use> uses;
+	};
+	struct State {
+		// last write, and the stages reading since, which already wait for it
+		vk::PipelineStageFlags writeStages;
+		vk::AccessFlags writeAccess;
+		vk::PipelineStageFlags readStages;
+		vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+	};
+
+	void _addUse(std::size_t pass, uint64_t handle, vk::Image image, vk::AccessFlags access, vk::ImageLayout layout);
+	void _barrier(const vk::CommandBuffer& cmdBuf, const Pass& pass);
+
+	std::vector<Pass> m_passes;
+	// keyed by handle, images and buffers apart as their handles may collide
+	std::map<uint64_t, State> m_imageStates;
+	std::map<uint64_t, State> m_bufferStates;
+	std::map<uint64_t, std::vector<uint64_t>> m_transientAliases;
+	// transient images already used in the frame being recorded
+	std::set<uint64_t> m_discarded;
+	uint32_t m_barrierCount = 0;
+};
@@ -0,0 +1,47 @@
+#include "resolutionController.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const double SmoothingAlpha = 0.1;
+// over budget reacts faster than under budget, so that frames are dropped as little as possible
+const double OverBudgetThreshold = 1.05;
+const double UnderBudgetThreshold = 0.85;
+const float ScaleStep = 1.0f / 40.0f;
+// frames to wait after a change, the first frames at a new size are not representative
+const int CooldownFrames = 10;
+}
+
+void ResolutionController::reset(float scale) {
+	m_scale = std::clamp(scale, m_minScale, m_maxScale);
+	m_smoothedMs = 0.0;
+	m_cooldown = CooldownFrames;
+}
+
+float ResolutionController::update(double gpuMs) {
+	if (gpuMs <= 0.0) {
+		return m_scale;
+	}
+	m_smoothedMs = m_smoothedMs == 0.0 ? gpuMs : m_smoothedMs + (gpuMs - m_smoothedMs) * SmoothingAlpha;
+	if (m_cooldown > 0) {
+		--m_cooldown;
+		return m_scale;
+	}
+
+	double ratio = m_smoothedMs / m_targetMs;
+	if (ratio < OverBudgetThreshold && ratio > UnderBudgetThreshold) {
+		return m_scale;
+	}
+	// the cost is roughly proportional to the pixel count, i.e. to the square of the scale
+	float scale = m_scale * float(std::clamp(std::sqrt(1.0 / ratio), 0.8, 1.1));
+	scale = std::round(scale / ScaleStep) * ScaleStep;
+	scale = std::clamp(scale, m_minScale, m_maxScale);
+	if (scale != m_scale) {
+		m_scale = scale;
+		// measure the new size from scratch
+		m_smoothedMs = 0.0;
+		m_cooldown = CooldownFrames;
+	}
+	return m_scale;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Picks the render scale (fraction of the window size per axis) from the measured GPU frame time,
+// so that the frame stays within a target budget. The GPU time is smoothed, the scale only changes
+// once the budget is clearly missed or clearly undershot, and it is quantized to avoid resetting
+// the accumulation on every frame.
+class ResolutionController {
+public:
+	// Returns the scale for the next frame
+	float update(double gpuMs);
+	void reset(float scale = 1.0f);
+
+	[[nodiscard]] float getScale() const {
+		return m_scale;
+	}
+	[[nodiscard]] double getSmoothedMs() const {
+		return m_smoothedMs;
+	}
+
+	float m_targetMs = 15.0f;
+	float m_minScale = 0.5f;
+	float m_maxScale = 1.0f;
+
+private:
+	float m_scale = 1.0f;
+	double m_smoothedMs = 0.0;
+	int m_cooldown = 0;
+};
@@ -24,10 +24,13 @@ void SceneBuffers::_loadEnvironment() {
 	vk::ImageCreateInfo   icInfo = nvvk::makeImage2DCreateInfo(imageSize, format);
 	{
 		nvvk::ScopeCommandBuffer cmdBuf(m_device, m_graphicsQueueIndex);
+		startupTrace.beginGpu(cmdBuf, "Environment Upload");
 		nvvk::Image              image = m_alloc->createImage(cmdBuf, bufferSize, pixels, icInfo);
 		vk::ImageViewCreateInfo  ivInfo = nvvk::makeImageViewCreateInfo(image.image, icInfo);
 		m_environmentalTexture = m_alloc->createTexture(image, ivInfo, samplerCreateInfo);
+		startupTrace.endGpu(cmdBuf);
 	}
+	startupTrace.resolveGpu();
 	m_alloc->finalizeAndReleaseStaging();
 
 	const uint32_t rx = width;
@@ -61,6 +64,7 @@ void SceneBuffers::_loadEnvironment() {
 
 	{
 		nvvk::ScopeCommandBuffer cmdBuf(m_device, m_graphicsQueueIndex);
+		startupTrace.beginGpu(cmdBuf, "Environment Alias Map Upload");
 		vk::SamplerCreateInfo samplerCreateInfo{};
 		vk::Format            format = vk::Format::eR32G32B32A32Sfloat;
 		vk::ImageCreateInfo   icInfo = nvvk::makeImage2DCreateInfo({ rx, ry }, format);
@@ -69,7 +73,9 @@ void SceneBuffers::_loadEnvironment() {
 		nvvk::Image              image = m_alloc->createImage(cmdBuf, bufferSize, aliasTable.data(), icInfo);
 		vk::ImageViewCreateInfo  ivInfo = nvvk::makeImageViewCreateInfo(image.image, icInfo);
 		m_environmentAliasMap = m_alloc->createTexture(image, ivInfo, samplerCreateInfo);
+		startupTrace.endGpu(cmdBuf);
 	}
+	startupTrace.resolveGpu();
 	m_alloc->finalizeAndReleaseStaging();
 	std::cout << "etotal: " << total << std::endl;
 	stbi_image_free(pixels);
@@ -1,5 +1,5 @@
 #pragma once
-#define NVVK_ALLOC_DEDICATED
+#define NVVK_ALLOC_DMA
 #include <queue>
 #include <vulkan/vulkan.hpp>
 #include <nvmath/nvmath.h>
@@ -12,8 +12,12 @@
 #include "nvvk/raytraceKHR_vk.hpp"
 
 #include "util.h"
+#include "asBuilder.h"
+#include "memoryStats.h"
+#include "startupTrace.h"
 #include "shaders/headers/binding.glsl"
 extern bool GeneratePointLight;
+extern vk::DeviceSize blasScratchBudget;
 
 class SceneBuffers {
 public:
@@ -73,6 +77,24 @@ public:
 	[[nodiscard]] const nvvk::Texture& getEnvironmentalAliasMap() const {
 		return m_environmentAliasMap;
 	}
+	[[nodiscard]] const AsBuilder::Stats& getAsStats() const {
+		return m_asBuilder.getStats();
+	}
+
+	[[nodiscard]] vk::DeviceSize getGeometryBytes() const {
+		return getBufferBytes(m_device, {
+			m_vertices.buffer, m_normals.buffer, m_texcoords.buffer, m_indices.buffer, m_tangents.buffer, m_colors.buffer,
+			m_materials.buffer, m_matrices.buffer, m_primlooks.buffer,
+			m_ptLightsBuffer.buffer, m_triangleLightsBuffer.buffer, m_aliasTableBuffer.buffer });
+	}
+	[[nodiscard]] vk::DeviceSize getTextureBytes() const {
+		std::vector<vk::Image> images{ m_environmentalTexture.image, m_environmentAliasMap.image,
+			m_defaultNormal.image, m_defaultWhite.image };
+		for (const nvvk::Texture& texture : m_textures) {
+			images.push_back(texture.image);
+		}
+		return getImageBytes(m_device, images);
+	}
 
 	vk::DescriptorSetLayout& getDescLayout() { return m_sceneDescSetLayout; }
 	vk::DescriptorSet& getDescSet() { return m_sceneDescSet; }
@@ -96,13 +118,20 @@ public:
 		nvvk::CommandPool cmdBufGet(device, graphicsQueueIndex);
 		vk::CommandBuffer cmdBuf = cmdBufGet.createCommandBuffer();
 
-		m_pointLights = collectPointLights(gltfScene);
-		m_triangleLights = collectTriangleLights(gltfScene);
-		if (m_pointLights.empty() && m_triangleLights.empty()) {
-			m_pointLights = generatePointLights(gltfScene.m_dimensions.min, gltfScene.m_dimensions.max);
+		{
+			StartupTrace::Zone zone("Light Collection");
+			m_pointLights = collectPointLights(gltfScene);
+			m_triangleLights = collectTriangleLights(gltfScene, tmodel);
+			if (m_pointLights.empty() && m_triangleLights.empty()) {
+				m_pointLights = generatePointLights(gltfScene.m_dimensions.min, gltfScene.m_dimensions.max);
+			}
 		}
 
-		_loadEnvironment();
+		{
+			StartupTrace::Zone zone("Environment Preprocessing");
+			_loadEnvironment();
+		}
+		startupTrace.beginGpu(cmdBuf, "Scene Upload");
 
 		// Lights
 		m_pointLightCount = m_pointLights.size();
@@ -196,55 +225,63 @@ public:
 			m_textures.emplace_back(alloc->createTexture(cmdBuf, 4, white.data(), nvvk::makeImage2DCreateInfo(vk::Extent2D{ 1, 1 }), {}));
 			m_debug.setObjectName(m_textures.back().image, "dummy");
 		};
-		if (tmodel.images.empty())
 		{
-			// No images, add a default one.
-			addDefaultTexture();
-		}
-		else {
-			m_textures.resize(tmodel.textures.size());
-			// load textures
-			for (int i = 0; i < tmodel.textures.size(); ++i) {
-				int sourceImage = tmodel.textures[i].source;
-				if (sourceImage >= tmodel.images.size() || sourceImage < 0)
-				{
-					// Incorrect source image
-					addDefaultTexture();
-					continue;
-				}
-				auto& gltfimage = tmodel.images[sourceImage];
-				if (gltfimage.width == -1 || gltfimage.height == -1 || gltfimage.image.empty())
-				{
-					// Image not present or incorrectly loaded (image.empty)
-					addDefaultTexture();
-					continue;
-				}
-				void* buffer = &gltfimage.image[0];
-				VkDeviceSize bufferSize = gltfimage.image.size();
-				auto         imgSize = vk::Extent2D(gltfimage.width, gltfimage.height);
-
-				//std::cout << "Loading Texture: " << gltfimage.uri << std::endl;
-				if (tmodel.textures[i].sampler > -1)
-				{
-					// Retrieve the texture sampler
-					auto gltfSampler = tmodel.samplers[tmodel.textures[i].sampler];
-					samplerCreateInfo = _gltfSamplerToVulkan(gltfSampler);
-				}
-				vk::ImageCreateInfo imageCreateInfo =
-					nvvk::makeImage2DCreateInfo(imgSize, format, vkIU::eSampled, true);
-
-				nvvk::Image image = alloc->createImage(cmdBuf, bufferSize, buffer, imageCreateInfo);
-				nvvk::cmdGenerateMipmaps(cmdBuf, image.image, format, imgSize, imageCreateInfo.mipLevels);
-				vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
-				m_textures[i] = alloc->createTexture(image, ivInfo, samplerCreateInfo);
-				m_debug.setObjectName(m_textures[i].image, std::string("Txt" + std::to_string(i)).c_str());
+			StartupTrace::Zone zone("Texture Upload");
+			if (tmodel.images.empty())
+			{
+				// No images, add a default one.
+				addDefaultTexture();
+			}
+			else {
+				m_textures.resize(tmodel.textures.size());
+				// load textures
+				for (int i = 0; i < tmodel.textures.size(); ++i) {
+					int sourceImage = tmodel.textures[i].source;
+					if (sourceImage >= tmodel.images.size() || sourceImage < 0)
+					{
+						// Incorrect source image
+						addDefaultTexture();
+						continue;
+					}
+					auto& gltfimage = tmodel.images[sourceImage];
+					if (gltfimage.width == -1 || gltfimage.height == -1 || gltfimage.image.empty())
+					{
+						// Image not present or incorrectly loaded (image.empty)
+						addDefaultTexture();
+						continue;
+					}
+					void* buffer = &gltfimage.image[0];
+					VkDeviceSize bufferSize = gltfimage.image.size();
+					auto         imgSize = vk::Extent2D(gltfimage.width, gltfimage.height);
+
+					//std::cout << "Loading Texture: " << gltfimage.uri << std::endl;
+					if (tmodel.textures[i].sampler > -1)
+					{
+						// Retrieve the texture sampler
+						auto gltfSampler = tmodel.samplers[tmodel.textures[i].sampler];
+						samplerCreateInfo = _gltfSamplerToVulkan(gltfSampler);
+					}
+					vk::ImageCreateInfo imageCreateInfo =
+						nvvk::makeImage2DCreateInfo(imgSize, format, vkIU::eSampled, true);
+
+					nvvk::Image image = alloc->createImage(cmdBuf, bufferSize, buffer, imageCreateInfo);
+					nvvk::cmdGenerateMipmaps(cmdBuf, image.image, format, imgSize, imageCreateInfo.mipLevels);
+					vk::ImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
+					m_textures[i] = alloc->createTexture(image, ivInfo, samplerCreateInfo);
+					m_debug.setObjectName(m_textures[i].image, std::string("Txt" + std::to_string(i)).c_str());
 
+				}
 			}
 		}
+		startupTrace.endGpu(cmdBuf);
 		cmdBufGet.submitAndWait(cmdBuf);
+		startupTrace.resolveGpu();
 		alloc->finalizeAndReleaseStaging();
 
-		_createRtBuffer(gltfScene);
+		{
+			StartupTrace::Zone zone("_createRtBuffer");
+			_createRtBuffer(gltfScene);
+		}
 	}
 
 	void createDescriptorSet(vk::DescriptorPool&  staticDescPool) {
@@ -272,7 +309,7 @@ public:
 
 		m_sceneDescSet = m_device.allocateDescriptorSets({ m_sceneDescPool, 1, &m_sceneDescSetLayout })[0];
 
-		vk::AccelerationStructureKHR                   tlas = m_rtBuilder.getAccelerationStructure();
+		vk::AccelerationStructureKHR                   tlas = m_asBuilder.getAccelerationStructure();
 		vk::WriteDescriptorSetAccelerationStructureKHR descASInfo;
 		descASInfo.setAccelerationStructureCount(1);
 		descASInfo.setPAccelerationStructures(&tlas);
@@ -333,14 +370,14 @@ public:
 		m_device.destroy(m_sceneDescSetLayout);
 		m_device.destroy(m_sceneDescPool);
 
-		m_rtBuilder.destroy();
+		m_asBuilder.destroy();
 	}
 
 
 
 private:
 	nvvk::DebugUtil m_debug;
-	nvvk::AllocatorDedicated* m_alloc;
+	nvvk::AllocatorDma* m_alloc;
 	vk::Device m_device;
 	vk::PhysicalDevice m_physicalDevice;
 	uint32_t m_graphicsQueueIndex;
@@ -374,7 +411,7 @@ private:
 	nvvk::Texture m_environmentAliasMap;
 
 
-	nvvk::RaytracingBuilderKHR                          m_rtBuilder;
+	AsBuilder                                           m_asBuilder;
 	vk::PhysicalDeviceRayTracingPipelinePropertiesKHR   m_rtProperties;
 	nvvk::Buffer m_primlooks;
 
@@ -389,31 +426,42 @@ private:
 		auto properties = m_physicalDevice.getProperties2<vk::PhysicalDeviceProperties2,
 			vk::PhysicalDeviceRayTracingPipelinePropertiesKHR>();
 		m_rtProperties = properties.get<vk::PhysicalDeviceRayTracingPipelinePropertiesKHR>();
-		m_rtBuilder.setup(m_device, m_alloc, m_graphicsQueueIndex);
+		m_asBuilder.setup(m_device, m_physicalDevice, m_alloc, m_graphicsQueueIndex);
 		// BLAS - Storing each primitive in a geometry
-		std::vector<nvvk::RaytracingBuilderKHR::BlasInput> allBlas;
+		std::vector<AsBuilder::BlasInput> allBlas;
 		allBlas.reserve(gltfScene.m_primMeshes.size());
 		for (auto& primMesh : gltfScene.m_primMeshes)
 		{
 			auto geo = _primitiveToGeometry(m_device, primMesh);
 			allBlas.push_back({ geo });
 		}
-		m_rtBuilder.buildBlas(allBlas, vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace );
+		{
+			StartupTrace::Zone zone("BLAS Build");
+			m_asBuilder.buildBlas(allBlas, vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace, blasScratchBudget);
+		}
 
-		std::vector<nvvk::RaytracingBuilderKHR::Instance> tlas;
+		std::vector<AsBuilder::Instance> tlas;
 		tlas.reserve(gltfScene.m_nodes.size());
-		uint32_t instID = 0;
 		for (auto& node : gltfScene.m_nodes)
 		{
-			nvvk::RaytracingBuilderKHR::Instance rayInst;
+			AsBuilder::Instance rayInst;
 			rayInst.transform = node.worldMatrix;
 			rayInst.instanceCustomId = node.primMesh;  // gl_InstanceCustomIndexEXT: to find which primitive
 			rayInst.blasId = node.primMesh;
-			rayInst.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			rayInst.flags = vk::GeometryInstanceFlagBitsKHR::eTriangleFacingCullDisable;
 			rayInst.hitGroupId = 0;  // We will use the same hit group for all objects
 			tlas.emplace_back(rayInst);
 		}
-		m_rtBuilder.buildTlas(tlas, vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace);
+		{
+			StartupTrace::Zone zone("TLAS Build");
+			m_asBuilder.buildTlas(tlas, vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace);
+		}
+
+		const AsBuilder::Stats& asStats = m_asBuilder.getStats();
+		std::cout << "BLAS Num: " << asStats.blasCount << " in " << asStats.batchCount << " batches" << std::endl;
+		std::cout << "BLAS Memory: " << asStats.uncompactedBlasBytes / 1024 << " KB -> " << asStats.compactedBlasBytes / 1024 << " KB (compacted)" << std::endl;
+		std::cout << "AS Memory Peak: " << asStats.peakBytes / 1024 << " KB, Steady: " << asStats.steadyBytes / 1024 << " KB" << std::endl;
+
 		std::vector<shader::RtPrimitiveLookup> primLookup;
 		for (auto& primMesh : gltfScene.m_primMeshes)
 			primLookup.push_back({ primMesh.firstIndex, primMesh.vertexOffset, primMesh.materialIndex });
@@ -422,7 +470,7 @@ private:
 		cmdBufGet.submitAndWait(cmdBuf);
 		m_alloc->finalizeAndReleaseStaging();
 	}
-	[[nodiscard]] inline nvvk::RaytracingBuilderKHR::BlasInput _primitiveToGeometry(
+	[[nodiscard]] inline AsBuilder::BlasInput _primitiveToGeometry(
 		const vk::Device& device, const nvh::GltfPrimMesh& prim)
 	{
 		// Building part
@@ -450,7 +498,7 @@ private:
 		offset.setPrimitiveOffset(prim.firstIndex * sizeof(uint32_t));
 		offset.setTransformOffset(0);
 
-		nvvk::RaytracingBuilderKHR::BlasInput input;
+		AsBuilder::BlasInput input;
 		input.asGeometry.emplace_back(asGeom);
 		input.asBuildOffsetInfo.emplace_back(offset);
 		return input;
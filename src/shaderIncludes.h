@@ -37,4 +37,10 @@ namespace shader
 		int frame{0};
 		int initialize{1};
 	};
+
+	struct DenoisePushConstant
+	{
+		int iteration{0};
+		int stepSize{1};
+	};
 } // namespace shader
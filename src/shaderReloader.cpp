@@ -0,0 +1,274 @@
+#include "shaderReloader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+#include "nvh/fileoperations.hpp"
+#include "nvh/nvprint.hpp"
+
+#if NVP_SUPPORTS_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+extern std::vector<std::string> defaultSearchPaths;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// tags of the defines that differ from the default, joined with dots
+std::string currentVariant;
+
+std::string readText(const std::string& filename) {
+	std::ifstream file(filename, std::ios::binary);
+	std::stringstream text;
+	text << file.rdbuf();
+	return text.str();
+}
+
+fs::file_time_type writeTime(const std::string& filename) {
+	std::error_code error;
+	fs::file_time_type time = fs::last_write_time(filename, error);
+	return error ? fs::file_time_type::min() : time;
+}
+
+#if NVP_SUPPORTS_SHADERC
+shaderc_shader_kind shaderKind(const std::string& filename) {
+	std::string extension = fs::path(filename).extension().string();
+	if (extension == ".vert") return shaderc_vertex_shader;
+	if (extension == ".frag") return shaderc_fragment_shader;
+	if (extension == ".comp") return shaderc_compute_shader;
+	if (extension == ".rgen") return shaderc_raygen_shader;
+	if (extension == ".rmiss") return shaderc_miss_shader;
+	if (extension == ".rchit") return shaderc_closesthit_shader;
+	if (extension == ".rahit") return shaderc_anyhit_shader;
+	if (extension == ".rint") return shaderc_intersection_shader;
+	if (extension == ".rcall") return shaderc_callable_shader;
+	return shaderc_glsl_infer_from_source;
+}
+
+// Resolves #include "file" relative to the including file, like glslangValidator
+class Includer : public shaderc::CompileOptions::IncluderInterface {
+public:
+	shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type,
+		const char* requestingSource, size_t) override {
+		auto* include = new Include;
+		include->name = (fs::path(requestingSource).parent_path() / requestedSource).lexically_normal().string();
+		if (fs::exists(include->name)) {
+			include->content = readText(include->name);
+		}
+		else {
+			// an empty name reports the failure, the content holds the message
+			include->content = "cannot find " + std::string(requestedSource);
+			include->name.clear();
+		}
+		include->result.source_name = include->name.c_str();
+		include->result.source_name_length = include->name.size();
+		include->result.content = include->content.c_str();
+		include->result.content_length = include->content.size();
+		include->result.user_data = include;
+		return &include->result;
+	}
+
+	void ReleaseInclude(shaderc_include_result* data) override {
+		delete static_cast<Include*>(data->user_data);
+	}
+
+private:
+	struct Include {
+		shaderc_include_result result;
+		std::string name;
+		std::string content;
+	};
+};
+#endif
+
+}  // namespace
+
+std::string shaderSpv(const std::string& shader) {
+	return currentVariant.empty() ? shader + ".spv" : shader + "." + currentVariant + ".spv";
+}
+
+void ShaderReloader::setDefine(const std::string& name, const std::string& value, const std::string& tag) {
+	m_defines[name] = value;
+	m_tags[name] = tag;
+	currentVariant.clear();
+	for (const auto& define : m_tags) {
+		if (!define.second.empty()) {
+			currentVariant += (currentVariant.empty() ? "" : ".") + define.second;
+		}
+	}
+}
+
+std::string ShaderReloader::_variantSpvPath(const WatchedShader& shader) const {
+	return (fs::path(shader.spvPath).parent_path() / fs::path(shaderSpv(shader.name)).filename()).string();
+}
+
+std::vector<std::string> ShaderReloader::getShaders() const {
+	std::vector<std::string> names;
+	for (const WatchedShader& shader : m_shaders) {
+		names.push_back(shader.name);
+	}
+	return names;
+}
+
+std::vector<std::string> ShaderReloader::compileVariant() {
+	std::vector<std::string> compiled;
+	m_lastError.clear();
+	for (WatchedShader& shader : m_shaders) {
+		_scanDependencies(shader);
+		fs::file_time_type spvTime = writeTime(_variantSpvPath(shader));
+		bool outdated = std::any_of(shader.dependencies.begin(), shader.dependencies.end(),
+			[&](const std::string& file) { return writeTime(file) > spvTime; });
+		if (outdated && _compile(shader)) {
+			compiled.push_back(shader.name);
+		}
+	}
+	return compiled;
+}
+
+void ShaderReloader::setup(const std::vector<std::string>& shaders) {
+	m_shaders.clear();
+	m_writeTimes.clear();
+	for (const std::string& name : shaders) {
+		WatchedShader shader;
+		shader.name = name;
+		shader.sourcePath = nvh::findFile(name, defaultSearchPaths);
+		shader.spvPath = nvh::findFile(name + ".spv", defaultSearchPaths);
+		if (shader.sourcePath.empty() || shader.spvPath.empty()) {
+			LOGW("Shader hot reload: %s or its .spv not found, not watched\n", name.c_str());
+			continue;
+		}
+		_scanDependencies(shader);
+		m_shaders.push_back(shader);
+	}
+	m_lastPoll = std::chrono::steady_clock::now();
+}
+
+bool ShaderReloader::isSupported() const {
+#if NVP_SUPPORTS_SHADERC
+	return true;
+#else
+	return false;
+#endif
+}
+
+void ShaderReloader::_scanDependencies(WatchedShader& shader) {
+	shader.dependencies = { shader.sourcePath };
+	_scanIncludes(shader.sourcePath, shader.dependencies);
+	for (const std::string& file : shader.dependencies) {
+		if (m_writeTimes.find(file) == m_writeTimes.end()) {
+			m_writeTimes[file] = writeTime(file);
+		}
+	}
+}
+
+void ShaderReloader::_scanIncludes(const std::string& file, std::vector<std::string>& dependencies) {
+	static const std::regex includePattern("^\\s*#\\s*include\\s+\"([^\"]+)\"");
+	std::istringstream text(readText(file));
+	std::string line;
+	std::smatch match;
+	while (std::getline(text, line)) {
+		if (!std::regex_search(line, match, includePattern)) {
+			continue;
+		}
+		std::string include = (fs::path(file).parent_path() / match[1].str()).lexically_normal().string();
+		if (std::find(dependencies.begin(), dependencies.end(), include) != dependencies.end() || !fs::exists(include)) {
+			continue;
+		}
+		dependencies.push_back(include);
+		_scanIncludes(include, dependencies);
+	}
+}
+
+std::vector<std::string> ShaderReloader::poll(bool force) {
+	std::vector<std::string> reloaded;
+	auto now = std::chrono::steady_clock::now();
+	if (!force && now - m_lastPoll < m_pollInterval) {
+		return reloaded;
+	}
+	m_lastPoll = now;
+
+	std::vector<std::string> changedFiles;
+	for (auto& file : m_writeTimes) {
+		fs::file_time_type time = writeTime(file.first);
+		if (time != file.second) {
+			file.second = time;
+			changedFiles.push_back(file.first);
+		}
+	}
+	if (!force && changedFiles.empty()) {
+		return reloaded;
+	}
+
+	bool failed = false;
+	for (WatchedShader& shader : m_shaders) {
+		bool changed = force || std::any_of(shader.dependencies.begin(), shader.dependencies.end(),
+			[&](const std::string& file) {
+				return std::find(changedFiles.begin(), changedFiles.end(), file) != changedFiles.end();
+			});
+		if (!changed) {
+			continue;
+		}
+		// includes may have been added or removed
+		_scanDependencies(shader);
+		if (_compile(shader)) {
+			reloaded.push_back(shader.name);
+		}
+		else {
+			failed = true;
+		}
+	}
+	if (!failed) {
+		m_lastError.clear();
+	}
+	return reloaded;
+}
+
+bool ShaderReloader::_compile(const WatchedShader& shader) {
+#if NVP_SUPPORTS_SHADERC
+	shaderc::Compiler compiler;
+	shaderc::CompileOptions options;
+	options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+	options.SetIncluder(std::make_unique<Includer>());
+	for (const auto& define : m_defines) {
+		options.AddMacroDefinition(define.first, define.second);
+	}
+
+	shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(
+		readText(shader.sourcePath), shaderKind(shader.sourcePath), shader.sourcePath.c_str(), options);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+		m_lastError = result.GetErrorMessage();
+		LOGE("Shader hot reload: %s failed, keeping the previous pipeline\n%s", shader.name.c_str(), m_lastError.c_str());
+		return false;
+	}
+
+	// written aside then renamed, an interrupted write never leaves a truncated .spv to load
+	std::string spvPath = _variantSpvPath(shader);
+	std::string tmpPath = spvPath + ".tmp";
+	{
+		std::ofstream spv(tmpPath, std::ios::binary | std::ios::trunc);
+		spv.write(reinterpret_cast<const char*>(result.cbegin()),
+			std::streamsize((result.cend() - result.cbegin()) * sizeof(uint32_t)));
+		if (!spv) {
+			m_lastError = "cannot write " + tmpPath;
+			LOGE("Shader hot reload: %s\n", m_lastError.c_str());
+			return false;
+		}
+	}
+	std::error_code error;
+	fs::rename(tmpPath, spvPath, error);
+	if (error) {
+		m_lastError = "cannot write " + spvPath;
+		LOGE("Shader hot reload: %s\n", m_lastError.c_str());
+		return false;
+	}
+	LOGI("Shader hot reload: %s recompiled\n", shader.name.c_str());
+	return true;
+#else
+	m_lastError = "built without shaderc, cannot recompile " + shader.name;
+	return false;
+#endif
+}
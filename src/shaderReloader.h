@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// SPIR-V file of a shader in the variant of the current defines, e.g. "src/shaders/restir.rgen.k4.spv"
+// with RESERVOIR_SIZE=4, or the default "src/shaders/restir.rgen.spv"
+std::string shaderSpv(const std::string& shader);
+
+// Watches GLSL sources and the files they #include, and recompiles the shaders whose sources changed
+// with the embedded shaderc compiler. The SPIR-V overwrites the .spv of the current variant loaded by
+// the passes, so a pipeline is rebuilt by simply recreating it. Failed compilations leave the previous
+// .spv untouched. Each variant has .spv of its own, the default ones only ever hold the default defines.
+class ShaderReloader {
+public:
+	// shaders are paths relative to the search paths, e.g. "src/shaders/restir.rgen"
+	void setup(const std::vector<std::string>& shaders);
+
+	// Checks the sources at most every m_pollInterval, or immediately when forced.
+	// Returns the shaders that were recompiled successfully.
+	std::vector<std::string> poll(bool force = false);
+
+	// Passed to every following compilation and selects the variant, e.g. setDefine("RESERVOIR_SIZE", "4", "k4").
+	// The tag names the .spv of the variant, it is empty for the value the default .spv are compiled with.
+	void setDefine(const std::string& name, const std::string& value, const std::string& tag);
+
+	// Compiles the shaders whose .spv of the current variant is missing or older than their sources.
+	// Returns the shaders that were recompiled successfully, getLastError() tells whether some failed.
+	std::vector<std::string> compileVariant();
+
+	[[nodiscard]] std::vector<std::string> getShaders() const;
+
+	[[nodiscard]] bool isSupported() const;
+	[[nodiscard]] const std::string& getLastError() const {
+		return m_lastError;
+	}
+
+private:
+	struct WatchedShader {
+		std::string name;
+		std::string sourcePath;
+		std::string spvPath;
+		std::vector<std::string> dependencies;
+	};
+
+	void _scanDependencies(WatchedShader& shader);
+	void _scanIncludes(const std::string& file, std::vector<std::string>& dependencies);
+	bool _compile(const WatchedShader& shader);
+	[[nodiscard]] std::string _variantSpvPath(const WatchedShader& shader) const;
+
+	std::vector<WatchedShader> m_shaders;
+	std::map<std::string, std::filesystem::file_time_type> m_writeTimes;
+	std::map<std::string, std::string> m_defines;
+	std::map<std::string, std::string> m_tags;
+	std::chrono::steady_clock::time_point m_lastPoll;
+	std::chrono::milliseconds m_pollInterval{ 500 };
+	std::string m_lastError;
+};
@@ -8,3 +8,6 @@
 #define DEBUG_METALLIC 5
 #define DEBUG_WORLD_POSITION 6
 #define DEBUG_NAIVE_POINT_LIGHT_NO_SHADOW 7
+#define DEBUG_WORLD_GRID_OCCUPANCY 8
+#define DEBUG_PHAT_HALF_ERROR 9
+#define DEBUG_SHADER_COST 10
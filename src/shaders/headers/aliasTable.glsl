@@ -0,0 +1,15 @@
+// Needs the AliasTable buffer declared as aliasTable
+
+void aliasTableSample(float r1, float r2, out uint index, out float probability) {
+	uint selected_column = min(uint(uniforms.aliasTableCount * r1), uniforms.aliasTableCount - 1);
+	aliasTableCell col = aliasTable.aliasCol[selected_column];
+	if (col.prob > r2) {
+		index = selected_column;
+		probability = col.pdf;
+	}
+	else {
+		index = col.alias;
+		probability = col.aliasPdf;
+	}
+	//probability *= uniforms.aliasTableCount; //scaling
+}
@@ -18,6 +18,9 @@
 #define B_TRIANGLE_LIGHTS 2
 #define B_ENVIRONMENTAL_MAP 3
 #define B_ENVIRONMENTAL_ALIAS_MAP 4
+#define B_PRESAMPLED_LIGHTS 5
+#define B_WORLD_GRID_CELLS 6
+#define B_WORLD_GRID_RESERVOIRS 7
 
 #define B_FRAME_WORLD_POSITION 0
 #define B_FRAME_ALBEDO 1
@@ -34,4 +37,25 @@
 #define B_TMP_RESERVIORS_INFO 12
 #define B_TMP_RESERVIORS_WEIGHT 13
 #define B_STORAGE_IMAGE 14
+#define B_DENOISE_HISTORY_COLOR 15
+#define B_DENOISE_HISTORY_MOMENTS 16
+#define B_PREV_DENOISE_HISTORY_COLOR 17
+#define B_PREV_DENOISE_HISTORY_MOMENTS 18
+#define B_DENOISE_PING 19
+#define B_DENOISE_PONG 20
+#define B_DENOISE_OUTPUT 21
+#define B_CANDIDATE_BUDGET 22
+#define B_CANDIDATE_STATS 23
+#define B_RADIANCE 24
+#define B_LIGHT_CELL_COUNTS 25
+#define B_LIGHT_CELL_ENTRIES 26
+#define B_GI_RESERVOIRS_SAMPLE 27
+#define B_GI_RESERVOIRS_RADIANCE 28
+#define B_PREV_GI_RESERVOIRS_SAMPLE 29
+#define B_PREV_GI_RESERVOIRS_RADIANCE 30
+#define B_TMP_GI_RESERVOIRS_SAMPLE 31
+#define B_TMP_GI_RESERVOIRS_RADIANCE 32
+#define B_PIPELINE_STATS 33
+#define B_SHADER_COST 34
+#define B_PHAT_ERROR_STATS 35
 
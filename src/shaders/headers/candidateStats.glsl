@@ -0,0 +1,38 @@
+// Adaptive candidate counters, reduced in the subgroup so that a single lane does the atomics.
+// The sums are kept in a low and a high word, they overflow 32 bits at high resolutions with large budgets.
+// Needs the CandidateStats buffer as candidateStats and, with SUBGROUP_ARITHMETIC, the
+// GL_KHR_shader_subgroup_basic and GL_KHR_shader_subgroup_arithmetic extensions.
+
+#if SUBGROUP_ARITHMETIC
+#define ADD_CANDIDATE_SUM(low, high, value) { \
+	uint total = subgroupAdd(value); \
+	if (subgroupElect() && total != 0u) { \
+		uint previous = atomicAdd(candidateStats.low, total); \
+		if (previous + total < previous) { \
+			atomicAdd(candidateStats.high, 1u); \
+		} \
+	} \
+}
+
+#define ADD_CANDIDATE_COUNT(counter) { \
+	uint total = subgroupAdd(1u); \
+	if (subgroupElect()) { \
+		atomicAdd(candidateStats.counter, total); \
+	} \
+}
+#else
+// every lane does its own atomics
+#define ADD_CANDIDATE_SUM(low, high, value) { \
+	uint total = (value); \
+	if (total != 0u) { \
+		uint previous = atomicAdd(candidateStats.low, total); \
+		if (previous + total < previous) { \
+			atomicAdd(candidateStats.high, 1u); \
+		} \
+	} \
+}
+
+#define ADD_CANDIDATE_COUNT(counter) { \
+	atomicAdd(candidateStats.counter, 1u); \
+}
+#endif
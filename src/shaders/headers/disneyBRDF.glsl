@@ -87,3 +87,56 @@ float disneyBrdfLuminance(float cosIn, float cosOut, float cosHalf, float cosInH
 
 	return diffuse + specular;
 }
+
+#if HALF_PRECISION_PHAT
+// fp16 luminance BRDF for the target function, which only has to be proportional to the contribution.
+// The roughness is clamped higher so that GTR2 stays in the half range, and the terms are multiplied in fp32.
+#define HALF_MIN_ALPHA float16_t(0.02)
+
+float16_t schlickFresnelHalf(float16_t cos) {
+	float16_t m = clamp(float16_t(1.0) - cos, float16_t(0.0), float16_t(1.0));
+	float16_t sm = m * m;
+	return sm * sm * m;
+}
+
+float16_t GTR2Half(float16_t NdotH, float16_t a) {
+	float16_t a2 = a * a;
+	float16_t t = float16_t(1.0) + (a2 - float16_t(1.0)) * NdotH * NdotH;
+	// t * t is below the half range for smooth surfaces
+	return (a2 / t) / (float16_t(M_PI) * t);
+}
+
+float16_t smithG_GGXHalf(float16_t NdotV, float16_t alphaG) {
+	float16_t a = alphaG * alphaG;
+	float16_t b = NdotV * NdotV;
+	return float16_t(1.0) / (abs(NdotV) + max(sqrt(a + b - a * b), float16_t(0.0001)));
+}
+
+float disneyBrdfLuminanceHalf(float cosIn, float cosOut, float cosHalf, float cosInHalf, float albedoLuminance, float roughness, float metallic) {
+	if (cosIn < 0.0f) {
+		return 0.0f;
+	}
+	f16vec4 cosines = f16vec4(cosIn, cosOut, cosHalf, cosInHalf);
+	float16_t lum = float16_t(albedoLuminance);
+	float16_t rough = float16_t(roughness);
+	float16_t metal = float16_t(metallic);
+
+	float16_t fresnelIn = schlickFresnelHalf(cosines.x);
+	float16_t fresnelOut = schlickFresnelHalf(cosines.y);
+	float16_t fresnelDiffuse90 = float16_t(0.5) + float16_t(2.0) * cosines.w * cosines.w * rough;
+	float16_t fresnelDiffuse = mix(float16_t(1.0), fresnelDiffuse90, fresnelIn) * mix(float16_t(1.0), fresnelDiffuse90, fresnelOut);
+	float16_t diffuse = lum * fresnelDiffuse * (float16_t(1.0) - metal) / float16_t(M_PI);
+
+	float16_t a = max(HALF_MIN_ALPHA, rough * rough);
+	float16_t Ds = GTR2Half(cosines.z, a);
+	float16_t Gs = smithG_GGXHalf(cosines.x, a) * smithG_GGXHalf(cosines.y, a);
+	float16_t Fs = mix(mix(float16_t(0.04), lum, metal), float16_t(1.0), schlickFresnelHalf(cosines.w));
+
+	return float(diffuse) + float(Fs) * float(Gs) * float(Ds);
+}
+#else
+// without HALF_PRECISION_PHAT the shaders do not need fp16 support
+float disneyBrdfLuminanceHalf(float cosIn, float cosOut, float cosHalf, float cosInHalf, float albedoLuminance, float roughness, float metallic) {
+	return disneyBrdfLuminance(cosIn, cosOut, cosHalf, cosInHalf, albedoLuminance, roughness, metallic);
+}
+#endif
@@ -0,0 +1,128 @@
+// Reservoirs of one bounce indirect samples (ReSTIR GI).
+// Needs random.glsl and restirUtils.glsl.
+
+vec2 octEncode(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0f) {
+		e = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return e;
+}
+
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+// sampleInfo: position, octahedral normal. radianceWeight: half precision radiance, w, number of samples
+GIReservoir unpackGIReservoir(vec4 sampleInfo, vec4 radianceWeight) {
+	GIReservoir res;
+	res.samplePos = sampleInfo.xyz;
+	res.sampleNormal = octDecode(unpackSnorm2x16(floatBitsToUint(sampleInfo.w)));
+	res.radiance = vec3(unpackHalf2x16(floatBitsToUint(radianceWeight.x)), unpackHalf2x16(floatBitsToUint(radianceWeight.y)).x);
+	res.w = radianceWeight.z;
+	res.numStreamSamples = floatBitsToUint(radianceWeight.w);
+	res.pHat = 0.0f;
+	res.sumWeights = 0.0f;
+	return res;
+}
+
+void packGIReservoir(GIReservoir res, out vec4 sampleInfo, out vec4 radianceWeight) {
+	sampleInfo.xyz = res.samplePos;
+	sampleInfo.w = uintBitsToFloat(packSnorm2x16(octEncode(res.sampleNormal)));
+	radianceWeight.x = uintBitsToFloat(packHalf2x16(res.radiance.rg));
+	radianceWeight.y = uintBitsToFloat(packHalf2x16(vec2(res.radiance.b, 0.0f)));
+	radianceWeight.z = res.w;
+	radianceWeight.w = uintBitsToFloat(res.numStreamSamples);
+}
+
+GIReservoir newGIReservoir() {
+	GIReservoir result;
+	result.samplePos = vec3(0.0f);
+	result.sampleNormal = vec3(0.0f, 0.0f, 1.0f);
+	result.radiance = vec3(0.0f);
+	result.numStreamSamples = 0;
+	result.pHat = 0.0f;
+	result.sumWeights = 0.0f;
+	result.w = 0.0f;
+	return result;
+}
+
+// Radiance reflected towards the camera by the visible point from the sample
+vec3 evaluateGI(in GeometryInfo gInfo, vec3 samplePos, vec3 radiance) {
+	vec3 wi = samplePos - gInfo.worldPos;
+	if (dot(wi, gInfo.normal) <= 0.0f) {
+		return vec3(0.0f);
+	}
+	wi = normalize(wi);
+	vec3 wo = normalize(vec3(gInfo.camPos) - gInfo.worldPos);
+
+	float cosIn = dot(gInfo.normal, wi);
+	float cosOut = dot(gInfo.normal, wo);
+	vec3 halfVec = normalize(wi + wo);
+	float cosHalf = dot(gInfo.normal, halfVec);
+	float cosInHalf = dot(wi, halfVec);
+
+	return radiance * disneyBrdfColor(cosIn, cosOut, cosHalf, cosInHalf, gInfo.albedo.xyz, gInfo.roughness, gInfo.metallic) * cosIn;
+}
+
+// Target function of the sample of res at the visible point of gInfo
+float giPHat(in GeometryInfo gInfo, in GIReservoir res) {
+	return luminance(evaluateGI(gInfo, res.samplePos, res.radiance));
+}
+
+// Jacobian of the change of visible point of a sample reused from sourcePos (ReSTIR GI, eq. 11).
+// Zero when it is extreme, those samples are mostly noise.
+float giReuseJacobian(in GeometryInfo gInfo, vec3 sourcePos, in GIReservoir res) {
+	if (res.w <= 0.0f) {
+		return 0.0f;
+	}
+	vec3 toReceiver = gInfo.worldPos - res.samplePos;
+	vec3 toSource = sourcePos - res.samplePos;
+	float cosReceiver = abs(dot(normalize(toReceiver), res.sampleNormal));
+	float cosSource = abs(dot(normalize(toSource), res.sampleNormal));
+	float jacobian = cosReceiver * dot(toSource, toSource) / max(cosSource * dot(toReceiver, toReceiver), 1e-6f);
+	if (jacobian <= 0.0f || jacobian > GI_MAX_JACOBIAN || jacobian < 1.0f / GI_MAX_JACOBIAN) {
+		return 0.0f;
+	}
+	return jacobian;
+}
+
+void updateGIReservoir(inout GIReservoir res, in GIReservoir candidate, float weight, float pHat, inout uint seed) {
+	res.sumWeights += weight;
+	if (rnd(seed) * res.sumWeights < weight) {
+		res.samplePos = candidate.samplePos;
+		res.sampleNormal = candidate.sampleNormal;
+		res.radiance = candidate.radiance;
+		res.pHat = pHat;
+	}
+}
+
+// candidate.w is ignored, pdf is the solid angle pdf the sample was drawn with
+void addSampleToGIReservoir(inout GIReservoir res, in GIReservoir candidate, float pHat, float pdf, inout uint seed) {
+	res.numStreamSamples += 1;
+	if (pHat > 0.0f && pdf > 0.0f) {
+		updateGIReservoir(res, candidate, pHat / pdf, pHat, seed);
+	}
+}
+
+// pHat is the target function of other's sample at the receiving pixel and jacobian the one of its shift there.
+// The resampling weight uses pHat / jacobian, the reservoir keeps pHat itself for the weight of the sample.
+void combineGIReservoirs(inout GIReservoir self, in GIReservoir other, float pHat, float jacobian, inout uint seed) {
+	self.numStreamSamples += other.numStreamSamples;
+	if (jacobian <= 0.0f) {
+		return;
+	}
+	float weight = pHat / jacobian * other.w * other.numStreamSamples;
+	if (weight > 0.0f) {
+		updateGIReservoir(self, other, weight, pHat, seed);
+	}
+}
+
+void finalizeGIReservoir(inout GIReservoir res) {
+	res.w = res.pHat > 0.0f ? res.sumWeights / (res.numStreamSamples * res.pHat) : 0.0f;
+}
@@ -0,0 +1,70 @@
+// Froxel addressing shared by the light culling passes and the candidate generation.
+// Needs the SceneUniforms block declared as uniforms, and headers/random.glsl for lightCellSlot.
+
+float lightInfluenceRadius(float luminance) {
+	return sqrt(max(luminance, 0.0f) / uniforms.lightInfluenceThreshold);
+}
+
+uvec2 lightCullingTileCount() {
+	return (uniforms.screenSize + uvec2(LIGHT_CULLING_TILE_SIZE - 1)) / uvec2(LIGHT_CULLING_TILE_SIZE);
+}
+
+uint lightCellCount() {
+	uvec2 tiles = lightCullingTileCount();
+	return tiles.x * tiles.y * LIGHT_CULLING_SLICES;
+}
+
+int depthToSlice(float depth) {
+	float t = log(max(depth, LIGHT_CULLING_NEAR) / LIGHT_CULLING_NEAR) / log(uniforms.lightCullingFar / LIGHT_CULLING_NEAR);
+	return clamp(int(t * LIGHT_CULLING_SLICES), 0, LIGHT_CULLING_SLICES - 1);
+}
+
+float sliceToDepth(float slice) {
+	return LIGHT_CULLING_NEAR * pow(uniforms.lightCullingFar / LIGHT_CULLING_NEAR, slice / LIGHT_CULLING_SLICES);
+}
+
+uint lightCellIndex(ivec2 tile, int slice) {
+	uvec2 tiles = lightCullingTileCount();
+	return (uint(slice) * tiles.y + uint(tile.y)) * tiles.x + uint(tile.x);
+}
+
+// -1 when the point is beyond the culled depth range
+int lightCellOfPixel(ivec2 pixel, vec3 worldPos) {
+	float depth = -(uniforms.view * vec4(worldPos, 1.0f)).z;
+	if (depth > uniforms.lightCullingFar) {
+		return -1;
+	}
+	return int(lightCellIndex(pixel / LIGHT_CULLING_TILE_SIZE, depthToSlice(depth)));
+}
+
+// Point on the view ray through the tile center at the middle of the slice, where the lights of the cell are weighted.
+// minDistance2 keeps the lights inside the froxel from being favored beyond its own extent.
+void lightCellCenter(uint cell, out vec3 center, out float minDistance2) {
+	uvec2 tiles = lightCullingTileCount();
+	uvec2 tile = uvec2(cell % tiles.x, (cell / tiles.x) % tiles.y);
+	uint slice = cell / (tiles.x * tiles.y);
+
+	vec2 pixel = min((vec2(tile) + 0.5f) * LIGHT_CULLING_TILE_SIZE, vec2(uniforms.screenSize));
+	vec2 ndc = pixel / vec2(uniforms.screenSize) * 2.0f - 1.0f;
+	vec4 target = uniforms.projInverse * vec4(ndc, 1.0f, 1.0f);
+	vec3 viewDir = normalize(target.xyz);
+	float depth = sliceToDepth(float(slice) + 0.5f);
+	center = (uniforms.viewInverse * vec4(viewDir * (depth / -viewDir.z), 1.0f)).xyz;
+	float extent = sliceToDepth(float(slice) + 1.0f) - sliceToDepth(float(slice));
+	minDistance2 = max(extent * extent, 1e-4f);
+}
+
+float lightCellWeight(pointLight light, vec3 center, float minDistance2) {
+	vec3 d = light.pos.xyz - center;
+	return light.emission_luminance.w / max(dot(d, d), minDistance2);
+}
+
+// Entry of the table that the light stands in for when the cell overflows, and its key in the race for that entry.
+// The largest weight / Exp(1) wins, so each light wins with the probability of its share of the entry weight.
+// The entries and the exponentials change every frame.
+uint lightCellSlot(uint lightIndex, uint cell, float weight, out float key) {
+	uvec2 r = pcg2d(uvec2(lightIndex, cell ^ (uniforms.frameIndex * 0x9e3779b9u)));
+	float u = (float(r.y >> 8) + 0.5f) / 16777216.0f;
+	key = weight / -log(u);
+	return r.x % LIGHT_CELL_CAPACITY;
+}
@@ -0,0 +1,60 @@
+// Pipeline statistics counted per invocation in pipelineStatsCounts and added to the stats buffer once with
+// flushPipelineStats(): the lanes sum their counts in the subgroup and a single lane does the atomics.
+// Needs the SceneUniforms block declared as uniforms, the PipelineStats buffer as pipelineStats and, with
+// SUBGROUP_ARITHMETIC, the GL_KHR_shader_subgroup_basic and GL_KHR_shader_subgroup_arithmetic extensions.
+
+PipelineStats pipelineStatsCounts;
+
+void resetPipelineStats() {
+	pipelineStatsCounts.temporalTested = 0u;
+	pipelineStatsCounts.temporalOffscreen = 0u;
+	pipelineStatsCounts.temporalPositionRejected = 0u;
+	pipelineStatsCounts.temporalAlbedoRejected = 0u;
+	pipelineStatsCounts.temporalNormalRejected = 0u;
+	pipelineStatsCounts.spatialTested = 0u;
+	pipelineStatsCounts.spatialMerged = 0u;
+	pipelineStatsCounts.shadowRays = 0u;
+	pipelineStatsCounts.shadowRaysOccluded = 0u;
+	for (int i = 0; i < PIPELINE_STATS_M_BINS; ++i) {
+		pipelineStatsCounts.mHistogram[i] = 0u;
+	}
+}
+
+void countReservoirM(uint M) {
+	uint bin = M == 0u ? 0u : min(uint(findMSB(M)) + 1u, uint(PIPELINE_STATS_M_BINS - 1));
+	pipelineStatsCounts.mHistogram[bin] += 1u;
+}
+
+#if SUBGROUP_ARITHMETIC
+#define FLUSH_PIPELINE_STAT(counter) { \
+	uint total = subgroupAdd(pipelineStatsCounts.counter); \
+	if (subgroupElect() && total != 0u) { \
+		atomicAdd(pipelineStats.counter, total); \
+	} \
+}
+#else
+#define FLUSH_PIPELINE_STAT(counter) { \
+	if (pipelineStatsCounts.counter != 0u) { \
+		atomicAdd(pipelineStats.counter, pipelineStatsCounts.counter); \
+	} \
+}
+#endif
+
+// Once per invocation, the lanes that already left the shader are simply not part of the sums
+void flushPipelineStats() {
+	if ((uniforms.flags & PIPELINE_STATS_FLAG) == 0) {
+		return;
+	}
+	FLUSH_PIPELINE_STAT(temporalTested);
+	FLUSH_PIPELINE_STAT(temporalOffscreen);
+	FLUSH_PIPELINE_STAT(temporalPositionRejected);
+	FLUSH_PIPELINE_STAT(temporalAlbedoRejected);
+	FLUSH_PIPELINE_STAT(temporalNormalRejected);
+	FLUSH_PIPELINE_STAT(spatialTested);
+	FLUSH_PIPELINE_STAT(spatialMerged);
+	FLUSH_PIPELINE_STAT(shadowRays);
+	FLUSH_PIPELINE_STAT(shadowRaysOccluded);
+	for (int i = 0; i < PIPELINE_STATS_M_BINS; ++i) {
+		FLUSH_PIPELINE_STAT(mHistogram[i]);
+	}
+}
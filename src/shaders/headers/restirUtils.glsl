@@ -5,6 +5,19 @@ float luminance(vec3 v) {
 
 }
 
+// Whether candidates are generated for this pixel in the current frame.
+// The generating pixels rotate every frame so each pixel is refreshed every 2 (checkerboard) or 4 (quarter) frames.
+bool isGenerationPixel(ivec2 coord) {
+	if (uniforms.generationMode == GENERATION_MODE_CHECKERBOARD) {
+		return ((coord.x + coord.y + int(uniforms.frameIndex)) & 1) == 0;
+	}
+	if (uniforms.generationMode == GENERATION_MODE_QUARTER) {
+		int phase = int(uniforms.frameIndex & 3u);
+		return (coord & 1) == ivec2(phase & 1, phase >> 1);
+	}
+	return true;
+}
+
 vec3 getTrianglePoint(float r1, float r2, vec3 p1, vec3 p2, vec3 p3) {
 	float sqrt_r1 = sqrt(r1);
 	return (1.0 - sqrt_r1) * p1 + (sqrt_r1 * (1.0 - r2)) * p2 + (r2 * sqrt_r1) * p3;
@@ -34,8 +47,36 @@ vec4 EnvironmentSample(uint selected_idx, vec3 to_light) {
 
 
 
+// wi is the unnormalized vector to the light sample
+float evaluatePHatAt(vec3 wi, float emissionLum, float LdotN, in GeometryInfo gInfo, bool halfPrecision) {
+	if (dot(wi, gInfo.normal) < 0.0f) {
+		return 0.0f;
+	}
+
+	float sqrDist = dot(wi, wi);
+	wi /= sqrt(sqrDist);
+	vec3 wo = normalize(vec3(gInfo.camPos) - gInfo.worldPos);
+
+	float cosIn = dot(gInfo.normal, wi);
+	float cosOut = dot(gInfo.normal, wo);
+	vec3 halfVec = normalize(wi + wo);
+	float cosHalf = dot(gInfo.normal, halfVec);
+	float cosInHalf = dot(wi, halfVec);
+
+	float geometry = LdotN * cosIn / sqrDist;
+
+	float brdf = halfPrecision
+		? disneyBrdfLuminanceHalf(cosIn, cosOut, cosHalf, cosInHalf, gInfo.albedoLum, gInfo.roughness, gInfo.metallic)
+		: disneyBrdfLuminance(cosIn, cosOut, cosHalf, cosInHalf, gInfo.albedoLum, gInfo.roughness, gInfo.metallic);
+	return emissionLum * brdf * geometry;
+}
+
+float evaluatePHatAt(vec3 wi, float emissionLum, float LdotN, in GeometryInfo gInfo) {
+	return evaluatePHatAt(wi, emissionLum, LdotN, gInfo, HALF_PRECISION_PHAT != 0);
+}
+
 float evaluatePHat(
-	uint lightIdx, int lightKind, in GeometryInfo gInfo
+	uint lightIdx, int lightKind, in GeometryInfo gInfo, bool halfPrecision
 ) {
 	vec3 wi;
 	float emissionLum;
@@ -58,24 +99,11 @@ float evaluatePHat(
 		vec4 col = 1.0f / uniforms.environmentalPower * EnvironmentSample(lightIdx, wi);
 		emissionLum = 1.0f / uniforms.environmentalPower * col.a;
 	}
-	if (dot(wi, gInfo.normal) < 0.0f) {
-		return 0.0f;
-	}
-
-	float sqrDist = dot(wi, wi);
-	wi /= sqrt(sqrDist);
-	vec3 wo = normalize(vec3(gInfo.camPos) - gInfo.worldPos);
-
-	float cosIn = dot(gInfo.normal, wi);
-	float cosOut = dot(gInfo.normal, wo);
-	vec3 halfVec = normalize(wi + wo);
-	float cosHalf = dot(gInfo.normal, halfVec);
-	float cosInHalf = dot(wi, halfVec);
-
-	float geometry = LdotN * cosIn / sqrDist;
-
+	return evaluatePHatAt(wi, emissionLum, LdotN, gInfo, halfPrecision);
+}
 
-	return emissionLum * disneyBrdfLuminance(cosIn, cosOut, cosHalf, cosInHalf, gInfo.albedoLum, gInfo.roughness, gInfo.metallic) * geometry;
+float evaluatePHat(uint lightIdx, int lightKind, in GeometryInfo gInfo) {
+	return evaluatePHat(lightIdx, lightKind, gInfo, HALF_PRECISION_PHAT != 0);
 }
 
 vec3 evaluatePHatFull(
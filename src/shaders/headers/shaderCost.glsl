@@ -0,0 +1,14 @@
+// Per pixel clock cycles of the ReSTIR phases, shown by DEBUG_SHADER_COST and exported by App::_exportShaderCost.
+// Needs the SceneUniforms block declared as uniforms, the cost image as shaderCost and GL_ARB_shader_clock.
+// The clock is shared by the subgroup, so the cycles of a lane include the time waiting for diverged lanes.
+
+uint shaderCostClock() {
+	return clock2x32ARB().x;
+}
+
+// The cycles since start wrap around with the low 32 bits of the clock
+void storeShaderCost(ivec2 coord, int layer, uint start) {
+	if ((uniforms.flags & SHADER_COST_FLAG) != 0) {
+		imageStore(shaderCost, ivec3(coord, layer), uvec4(shaderCostClock() - start));
+	}
+}
@@ -0,0 +1,59 @@
+// World space hash grid of light reservoirs.
+// Needs the SceneUniforms block declared as uniforms and the WorldGridCells buffer as worldGridCells.
+
+uint worldGridKey(vec3 worldPos) {
+	ivec3 cell = ivec3(floor(worldPos / uniforms.worldGridCellSize)) + WORLD_GRID_AXIS_CELLS / 2;
+	uvec3 wrapped = uvec3(cell) & uvec3(WORLD_GRID_AXIS_CELLS - 1);
+	// 0 is the empty key, the released key is out of the range
+	return (wrapped.x | (wrapped.y << 10) | (wrapped.z << 20)) + 1u;
+}
+
+vec3 worldGridCellCenter(uint key) {
+	uint k = key - 1u;
+	ivec3 cell = ivec3(k & 1023u, (k >> 10) & 1023u, (k >> 20) & 1023u) - WORLD_GRID_AXIS_CELLS / 2;
+	return (vec3(cell) + 0.5f) * uniforms.worldGridCellSize;
+}
+
+uint worldGridHash(uint key) {
+	uint state = key * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return ((word >> 22u) ^ word) % uniforms.worldGridCellCount;
+}
+
+// Slot of the cell, -1 when the cell has none. Released slots are probed past like taken ones.
+int worldGridFind(uint key) {
+	uint slot = worldGridHash(key);
+	for (int i = 0; i < WORLD_GRID_MAX_PROBES; ++i) {
+		uint stored = worldGridCells[slot].key;
+		if (stored == key) {
+			return int(slot);
+		}
+		if (stored == WORLD_GRID_EMPTY_KEY) {
+			return -1;
+		}
+		slot = (slot + 1u) % uniforms.worldGridCellCount;
+	}
+	return -1;
+}
+
+// Same as worldGridFind, but takes a free slot for a new cell and keeps the cell alive.
+// The whole chain is searched before a released slot is reused, the cell may be stored past it.
+int worldGridFindOrClaim(uint key) {
+	int found = worldGridFind(key);
+	uint slot = found >= 0 ? uint(found) : worldGridHash(key);
+	for (int i = 0; i < WORLD_GRID_MAX_PROBES; ++i) {
+		uint stored = worldGridCells[slot].key;
+		if (stored == WORLD_GRID_EMPTY_KEY || stored == WORLD_GRID_RELEASED_KEY) {
+			uint previous = atomicCompSwap(worldGridCells[slot].key, stored, key);
+			stored = previous == stored ? key : previous;
+		}
+		if (stored == key) {
+			if (worldGridCells[slot].lastFrame != uniforms.frameIndex) {
+				worldGridCells[slot].lastFrame = uniforms.frameIndex;
+			}
+			return int(slot);
+		}
+		slot = (slot + 1u) % uniforms.worldGridCellCount;
+	}
+	return -1;
+}
@@ -1,5 +1,79 @@
+// light samples per reservoir, the reservoir images have a layer per sample.
+// Overridden when the shaders are recompiled at runtime for another size, see App::_setReservoirSize.
+#ifndef RESERVOIR_SIZE
+#define RESERVOIR_SIZE 1
+#endif
+// 1 evaluates the BRDF of the target function in fp16, needs shaderFloat16. Set the same way as RESERVOIR_SIZE.
+#ifndef HALF_PRECISION_PHAT
+#define HALF_PRECISION_PHAT 0
+#endif
+// 1 reduces the statistics counters in the subgroup before the atomics, needs subgroup arithmetic in the
+// raygen and compute stages. Devices without it run the variant compiled with 0, see App::createScene.
+#ifndef SUBGROUP_ARITHMETIC
+#define SUBGROUP_ARITHMETIC 1
+#endif
+
 #define SPATIAL_REUSE_GROUP_SIZE_X 64
 #define SPATIAL_REUSE_GROUP_SIZE_Y 1
+// neighbor candidates a lane merges per candidate it loads in the subgroup spatial reuse
+#define SUBGROUP_SPATIAL_REUSE_SHARING 4
+
+#define SHADE_GROUP_SIZE_X 16
+#define SHADE_GROUP_SIZE_Y 16
+// fixed point of the fp16 target function error sums, the error of a sample is clamped to 1
+#define PHAT_ERROR_SCALE 1048576.0f
+
+#define DENOISE_GROUP_SIZE_X 16
+#define DENOISE_GROUP_SIZE_Y 16
+#define DENOISE_ALBEDO_EPSILON 0.001f
+#define DENOISE_MAX_HISTORY_LENGTH 32.0f
+
+#define ADAPTIVE_CANDIDATE_MIN_SCALE 0.25f
+#define ADAPTIVE_CANDIDATE_MAX_SCALE 4.0f
+#define ADAPTIVE_CANDIDATE_SCORE_SCALE 64.0f
+#define ADAPTIVE_CANDIDATE_MOMENT_ALPHA 0.2f
+
+// froxels: screen tiles split into exponential depth slices between the near plane and lightCullingFar
+#define LIGHT_CULLING_TILE_SIZE 32
+#define LIGHT_CULLING_SLICES 16
+#define LIGHT_CULLING_NEAR 0.1f
+#define LIGHT_CULLING_GROUP_SIZE 64
+// entries of a cell table, each entry of a cell with more lights stands in for the lights hashed to it
+#define LIGHT_CELL_CAPACITY 32
+
+// light samples drawn from the global alias table once per frame, pixels pick one tile and draw all their candidates from it
+#define LIGHT_PRESAMPLE_TILE_COUNT 128
+#define LIGHT_PRESAMPLE_TILE_SIZE 1024
+#define LIGHT_PRESAMPLE_GROUP_SIZE 256
+
+// world space hash grid of light reservoirs, cells are addressed with 10 bits per axis
+#define WORLD_GRID_AXIS_CELLS 1024
+#define WORLD_GRID_EMPTY_KEY 0u
+// a released cell, the probes go on past it and a new cell may take its slot
+#define WORLD_GRID_RELEASED_KEY 0xFFFFFFFFu
+#define WORLD_GRID_MAX_PROBES 8
+// cells no pixel has landed in for this many frames are released
+#define WORLD_GRID_MAX_AGE 8u
+#define WORLD_GRID_CANDIDATES 8
+#define WORLD_GRID_GROUP_SIZE 128
+
+#define GI_SPATIAL_REUSE_GROUP_SIZE_X 16
+#define GI_SPATIAL_REUSE_GROUP_SIZE_Y 16
+// reused indirect samples are rejected when the solid angle changes more than this factor between the visible points
+#define GI_MAX_JACOBIAN 10.0f
+
+// bin 0 counts the reservoirs with M = 0, bin i the ones with M in [2^(i-1), 2^i), the last one everything above
+#define PIPELINE_STATS_M_BINS 12
+
+// layers of the shader cost image: the clock cycles of the phases of a pixel, then the material of its primary hit + 1
+#define SHADER_COST_PRIMARY_RAY 0
+#define SHADER_COST_CANDIDATES 1
+#define SHADER_COST_VISIBILITY 2
+#define SHADER_COST_TEMPORAL 3
+#define SHADER_COST_SPATIAL 4
+#define SHADER_COST_PHASES 5
+#define SHADER_COST_MATERIAL 5
+#define SHADER_COST_LAYERS 6
 
 
 struct GeometryInfo {
@@ -14,10 +88,8 @@ struct GeometryInfo {
 	uint sampleSeed;
 };
 
-struct Reservoir {
-	GeometryInfo info;
+struct ReservoirSample {
 	vec3 lightPos;
-	uint numStreamSamples;
 	uint lightIndex;
 	int lightKind;
 	uint sampleSeed;
@@ -26,11 +98,120 @@ struct Reservoir {
 	float w;
 };
 
+// the samples are selected independently from the same candidate stream, numStreamSamples is shared
+struct Reservoir {
+	GeometryInfo info;
+	uint numStreamSamples;
+	ReservoirSample samples[RESERVOIR_SIZE];
+};
+
+// one bounce indirect sample: the secondary hit point and the radiance it reflects towards the visible point
+struct GIReservoir {
+	vec3 samplePos;
+	vec3 sampleNormal;
+	vec3 radiance;
+	uint numStreamSamples;
+	float pHat;
+	float sumWeights;
+	float w;
+};
+
+// alias table entry of a light culling cell, pdf is the probability of picking light in the cell
+struct LightCellEntry {
+	uint light;
+	int alias;
+	float prob;
+	float pdf;
+};
+
+// the same memory while the lights are binned: the key of the light winning the entry and the summed weight
+// of the lights hashed to it as float bits, where LightCellEntry has its prob. See lightCullingBin.comp.
+struct LightCellBinEntry {
+	uint light;
+	uint key;
+	uint weight;
+	float pdf;
+};
+
+// everything the candidate generation reads of a light, so that a tile is read contiguously
+struct PresampledLight {
+	vec4 posPdf; // w is the alias table pdf, divided by the area for triangle lights
+	vec4 normalLum; // xyz is zero for point lights, w is the emission luminance
+	uint lightIndex;
+	int lightKind;
+	uint sampleSeed;
+	float padding;
+};
+
+struct WorldGridCell {
+	uint key;
+	uint lastFrame;
+};
+
+// light selected by RIS at the cell center, W is its unbiased contribution weight (the inverse pdf)
+struct WorldGridReservoir {
+	uint key;
+	uint lightIndex;
+	uint sampleSeed;
+	float W;
+};
+
+// the sums are 64 bits split in two words, see headers/candidateStats.glsl
+struct CandidateStats {
+	uint candidateSumLow;
+	uint candidateSumHigh;
+	uint pixelCount;
+	uint scoreSumLow;
+	uint scoreSumHigh;
+	uint scoredPixelCount;
+};
+
+// what the ReSTIR passes did over a frame, see headers/pipelineStats.glsl
+struct PipelineStats {
+	uint temporalTested;
+	// the first of the temporal reuse tests failing, or the pixel not being in the previous frame
+	uint temporalOffscreen;
+	uint temporalPositionRejected;
+	uint temporalAlbedoRejected;
+	uint temporalNormalRejected;
+	uint spatialTested;
+	uint spatialMerged;
+	uint shadowRays;
+	uint shadowRaysOccluded;
+	// M of the final reservoirs
+	uint mHistogram[PIPELINE_STATS_M_BINS];
+};
+
+// relative error of the fp16 target function against fp32 over the samples of the final reservoirs,
+// the sum is fixed point with PHAT_ERROR_SCALE in two words and the maximum is the bits of a positive float
+struct PHatErrorStats {
+	uint errorSumLow;
+	uint errorSumHigh;
+	uint maxError;
+	uint sampleCount;
+	// samples the fp16 target function rounded to zero
+	uint zeroedCount;
+};
+
 
 #define RESTIR_VISIBILITY_REUSE_FLAG (1 << 0)
 #define RESTIR_TEMPORAL_REUSE_FLAG (1 << 1)
 #define RESTIR_SPATIAL_REUSE_FLAG (1 << 2)
 #define USE_ENVIRONMENT_FLAG (1 << 3)
+#define DENOISER_FLAG (1 << 4)
+#define ADAPTIVE_CANDIDATES_FLAG (1 << 5)
+#define LIGHT_CULLING_FLAG (1 << 6)
+#define LIGHT_PRESAMPLING_FLAG (1 << 7)
+#define WORLD_GRID_FLAG (1 << 8)
+#define GI_FLAG (1 << 9)
+#define SUBGROUP_SPATIAL_REUSE_FLAG (1 << 10)
+#define PIPELINE_STATS_FLAG (1 << 11)
+#define SHADER_COST_FLAG (1 << 12)
+#define PHAT_ERROR_FLAG (1 << 13)
+
+#define GENERATION_MODE_FULL 0
+#define GENERATION_MODE_CHECKERBOARD 1
+#define GENERATION_MODE_QUARTER 2
 
 
 
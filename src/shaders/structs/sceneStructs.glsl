@@ -24,6 +24,7 @@ struct Payload {
 	vec3 emissive;
 	float roughness;
 	float metallic;
+	int materialIndex;
 	bool exist;
 };
 
@@ -95,5 +96,33 @@ struct SceneUniforms {
 
 	float environmentalPower;
 	float fireflyClampThreshold;
+
+	int denoiseIterations;
+	float denoiseTemporalAlpha;
+	float denoisePhiLuminance;
+	float denoisePhiNormal;
+	float denoisePhiPosition;
+
+	int generationMode;
+	uint frameIndex;
+
+	float candidateScoreMean;
+
+	// render size of the previous frame, the history buffers are laid out at that size
+	uvec2 prevScreenSize;
+	// size of the swapchain, screenSize is the sub-rectangle of the render targets rendered this frame
+	uvec2 displaySize;
+
+	// point lights only reach the distance where their luminance / d^2 falls below the threshold
+	float lightInfluenceThreshold;
+	float lightCullingFar;
+
+	float worldGridCellSize;
+	uint worldGridCellCount;
+	uint worldGridReservoirsPerCell;
+
+	// DEBUG_SHADER_COST shows this phase, or all of them at SHADER_COST_PHASES, red at shaderCostScale cycles
+	int shaderCostPhase;
+	float shaderCostScale;
 };
 
@@ -0,0 +1,142 @@
+#include "startupTrace.h"
+
+#include <cassert>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+StartupTrace startupTrace;
+
+namespace {
+// spans recorded in one submission at most
+const uint32_t maxGpuSpans = 8;
+// track of the GPU spans, the threads are numbered from 1 in the order they record
+const uint32_t gpuTid = 0;
+}  // namespace
+
+StartupTrace::Zone::Zone(const char* name) : m_name(name), m_enabled(startupTrace.isEnabled()) {
+	if (m_enabled) {
+		// numbered when opening a zone, the outer zones of the main thread open before the workers start
+		m_tid = startupTrace._threadId();
+		m_begin = startupTrace._now();
+	}
+}
+
+StartupTrace::Zone::~Zone() {
+	if (m_enabled) {
+		startupTrace._add(m_name, m_tid, m_begin, startupTrace._now());
+	}
+}
+
+double StartupTrace::_now() const {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_origin).count();
+}
+
+uint32_t StartupTrace::_threadId() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_threads.emplace(std::this_thread::get_id(), uint32_t(m_threads.size()) + 1).first->second;
+}
+
+void StartupTrace::_add(const char* name, uint32_t tid, double begin, double end) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_events.push_back({ name, tid, begin, end - begin });
+}
+
+void StartupTrace::setupGpu(const vk::Device& device, const vk::PhysicalDevice& physicalDevice) {
+	if (!m_enabled) {
+		return;
+	}
+	m_device = device;
+	m_timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+	m_queryPool = m_device.createQueryPool({ {}, vk::QueryType::eTimestamp, maxGpuSpans * 2 });
+}
+
+void StartupTrace::destroyGpu() {
+	if (m_queryPool) {
+		m_device.destroy(m_queryPool);
+		m_queryPool = vk::QueryPool();
+	}
+}
+
+void StartupTrace::beginGpu(const vk::CommandBuffer& cmdBuf, const char* name) {
+	if (!m_queryPool) {
+		return;
+	}
+	assert(!m_gpuOpen && m_gpuNames.size() < maxGpuSpans);
+	uint32_t index = static_cast<uint32_t>(m_gpuNames.size());
+	cmdBuf.resetQueryPool(m_queryPool, index * 2, 2);
+	cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_queryPool, index * 2);
+	m_gpuNames.push_back(name);
+	m_gpuOpen = true;
+}
+
+void StartupTrace::endGpu(const vk::CommandBuffer& cmdBuf) {
+	if (!m_queryPool) {
+		return;
+	}
+	assert(m_gpuOpen);
+	uint32_t index = static_cast<uint32_t>(m_gpuNames.size()) - 1;
+	cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_queryPool, index * 2 + 1);
+	m_gpuOpen = false;
+}
+
+void StartupTrace::resolveGpu() {
+	if (!m_queryPool || m_gpuNames.empty()) {
+		return;
+	}
+	double end = _now();
+	uint32_t queryCount = static_cast<uint32_t>(m_gpuNames.size()) * 2;
+	std::vector<uint64_t> timestamps(queryCount);
+	vk::Result result = m_device.getQueryPoolResults(m_queryPool, 0, queryCount,
+		timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+		vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+	if (result == vk::Result::eSuccess) {
+		auto toUs = [&](uint64_t timestamp) {
+			return end - double(timestamps[queryCount - 1] - timestamp) * m_timestampPeriod / 1000.0;
+		};
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (std::size_t i = 0; i < m_gpuNames.size(); ++i) {
+			double begin = toUs(timestamps[i * 2]);
+			m_events.push_back({ m_gpuNames[i], gpuTid, begin, toUs(timestamps[i * 2 + 1]) - begin });
+		}
+	}
+	m_gpuNames.clear();
+}
+
+bool StartupTrace::write(const std::string& filename) const {
+	std::ofstream out(filename);
+	if (!out) {
+		std::cerr << "Startup trace: cannot write " << filename << std::endl;
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	// microseconds with a fixed precision, the timestamps from the start of the program need more than the default digits
+	out << std::fixed << std::setprecision(3);
+	bool first = true;
+	auto next = [&]() {
+		out << (first ? "\t\t" : ",\n\t\t");
+		first = false;
+	};
+	auto threadName = [&](uint32_t tid, const std::string& name) {
+		next();
+		out << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid
+			<< ", \"args\": { \"name\": \"" << name << "\" } }";
+	};
+	out << "{\n";
+	out << "\t\"displayTimeUnit\": \"ms\",\n";
+	out << "\t\"traceEvents\": [\n";
+	threadName(gpuTid, "GPU");
+	for (const auto& thread : m_threads) {
+		threadName(thread.second, thread.second == 1 ? std::string("Main") : "Worker " + std::to_string(thread.second - 1));
+	}
+	for (const Event& event : m_events) {
+		next();
+		out << "{ \"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.tid
+			<< ", \"ts\": " << event.begin << ", \"dur\": " << event.duration << " }";
+	}
+	out << "\n";
+	out << "\t]\n";
+	out << "}\n";
+	std::cout << "Startup trace written to " << filename << std::endl;
+	return true;
+}
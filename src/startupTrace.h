@@ -0,0 +1,79 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Trace of the startup in the Chrome trace format, to open in chrome://tracing or Perfetto.
+// CPU zones are recorded on the thread that opens them, worker threads included. GPU spans of the
+// one-off submissions are recorded with timestamp queries and shown on a track of their own.
+// Nothing is recorded until enable() is called.
+class StartupTrace {
+public:
+	// Records the time from its construction to its destruction on the calling thread
+	class Zone {
+	public:
+		explicit Zone(const char* name);
+		~Zone();
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* m_name;
+		bool m_enabled;
+		uint32_t m_tid = 0;
+		double m_begin = 0.0;
+	};
+
+	void enable() {
+		m_enabled = true;
+	}
+	[[nodiscard]] bool isEnabled() const {
+		return m_enabled;
+	}
+
+	void setupGpu(const vk::Device& device, const vk::PhysicalDevice& physicalDevice);
+	void destroyGpu();
+
+	// Span of the commands recorded between the two calls, in a command buffer submitted and waited for
+	// before resolveGpu()
+	void beginGpu(const vk::CommandBuffer& cmdBuf, const char* name);
+	void endGpu(const vk::CommandBuffer& cmdBuf);
+	// Reads the spans of the submission just waited for. Without a clock shared with the CPU, its last
+	// timestamp is taken as the time the wait returned
+	void resolveGpu();
+
+	bool write(const std::string& filename) const;
+
+private:
+	struct Event {
+		std::string name;
+		uint32_t tid;
+		double begin;
+		double duration;
+	};
+
+	// microseconds since the start of the program
+	[[nodiscard]] double _now() const;
+	uint32_t _threadId();
+	void _add(const char* name, uint32_t tid, double begin, double end);
+
+	bool m_enabled = false;
+	std::chrono::steady_clock::time_point m_origin = std::chrono::steady_clock::now();
+
+	mutable std::mutex m_mutex;
+	std::vector<Event> m_events;
+	std::map<std::thread::id, uint32_t> m_threads;
+
+	vk::Device m_device;
+	vk::QueryPool m_queryPool;
+	double m_timestampPeriod = 1.0;
+	std::vector<const char*> m_gpuNames;
+	bool m_gpuOpen = false;
+};
+
+extern StartupTrace startupTrace;
@@ -0,0 +1,125 @@
+#include "transientMemory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace {
+bool livesOverlap(const TransientMemory::Block& a, const TransientMemory::Block& b) {
+	return a.firstPass <= b.lastPass && b.firstPass <= a.lastPass;
+}
+
+bool memoryOverlaps(const TransientMemory::Block& a, const TransientMemory::Block& b) {
+	return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+}
+
+vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+vk::DeviceSize TransientMemory::place(std::vector<Block>& blocks) {
+	std::vector<std::size_t> order(blocks.size());
+	std::iota(order.begin(), order.end(), std::size_t(0));
+	std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return blocks[a].size > blocks[b].size; });
+
+	vk::DeviceSize end = 0;
+	std::vector<std::size_t> placed;
+	for (std::size_t index : order) {
+		Block& block = blocks[index];
+		// the lowest offset, at the start or right after a block alive at the same time, that overlaps none of them
+		std::vector<vk::DeviceSize> candidates{ 0 };
+		for (std::size_t other : placed) {
+			if (livesOverlap(block, blocks[other])) {
+				candidates.push_back(alignUp(blocks[other].offset + blocks[other].size, block.alignment));
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+		for (vk::DeviceSize offset : candidates) {
+			block.offset = offset;
+			bool fits = std::none_of(placed.begin(), placed.end(), [&](std::size_t other) {
+				return livesOverlap(block, blocks[other]) && memoryOverlaps(block, blocks[other]);
+			});
+			if (fits) {
+				break;
+			}
+		}
+		placed.push_back(index);
+		end = std::max(end, block.offset + block.size);
+	}
+	return end;
+}
+
+void TransientMemory::setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice) {
+	m_device = device;
+	m_physicalDevice = physicalDevice;
+}
+
+void TransientMemory::add(vk::Image image, uint32_t firstPass, uint32_t lastPass) {
+	assert(!m_memory && firstPass <= lastPass);
+	vk::MemoryRequirements requirements = m_device.getImageMemoryRequirements(image);
+	Block block;
+	block.size = requirements.size;
+	block.alignment = requirements.alignment;
+	block.firstPass = firstPass;
+	block.lastPass = lastPass;
+	m_images.push_back(image);
+	m_blocks.push_back(block);
+	m_memoryTypeBits &= requirements.memoryTypeBits;
+}
+
+void TransientMemory::allocate() {
+	assert(!m_memory);
+	if (m_images.empty()) {
+		return;
+	}
+	m_allocatedBytes = place(m_blocks);
+
+	vk::PhysicalDeviceMemoryProperties properties = m_physicalDevice.getMemoryProperties();
+	uint32_t memoryType = properties.memoryTypeCount;
+	for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+		if ((m_memoryTypeBits & (1u << i))
+			&& (properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)) {
+			memoryType = i;
+			break;
+		}
+	}
+	assert(memoryType < properties.memoryTypeCount && "No device local memory type fits all the transient images");
+
+	m_memory = m_device.allocateMemory({ m_allocatedBytes, memoryType });
+	for (std::size_t i = 0; i < m_images.size(); ++i) {
+		m_device.bindImageMemory(m_images[i], m_memory, m_blocks[i].offset);
+	}
+}
+
+void TransientMemory::free() {
+	m_device.free(m_memory);
+	m_memory = vk::DeviceMemory();
+	m_images.clear();
+	m_blocks.clear();
+	m_memoryTypeBits = ~0u;
+	m_allocatedBytes = 0;
+}
+
+std::vector<vk::Image> TransientMemory::getAliases(vk::Image image) const {
+	std::vector<vk::Image> aliases;
+	auto it = std::find(m_images.begin(), m_images.end(), image);
+	if (it == m_images.end()) {
+		return aliases;
+	}
+	const Block& block = m_blocks[it - m_images.begin()];
+	for (std::size_t i = 0; i < m_images.size(); ++i) {
+		if (m_images[i] != image && memoryOverlaps(block, m_blocks[i])) {
+			aliases.push_back(m_images[i]);
+		}
+	}
+	return aliases;
+}
+
+vk::DeviceSize TransientMemory::getRequiredBytes() const {
+	vk::DeviceSize bytes = 0;
+	for (const Block& block : m_blocks) {
+		bytes += block.size;
+	}
+	return bytes;
+}
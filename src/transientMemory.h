@@ -0,0 +1,47 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+// One device memory allocation for the images only used within a frame. Images whose lifetimes in the
+// frame, ranges of pass indices, do not overlap may be placed at the same memory.
+class TransientMemory {
+public:
+	struct Block {
+		vk::DeviceSize size{ 0 };
+		vk::DeviceSize alignment{ 1 };
+		uint32_t firstPass{ 0 };
+		uint32_t lastPass{ 0 };
+		vk::DeviceSize offset{ 0 };
+	};
+
+	// Sets the offsets of the blocks, first fit by decreasing size, and returns the memory size they need
+	static vk::DeviceSize place(std::vector<Block>& blocks);
+
+	void setup(const vk::Device& device, const vk::PhysicalDevice& physicalDevice);
+
+	// The image is used from firstPass to lastPass of a frame. It is bound by allocate()
+	void add(vk::Image image, uint32_t firstPass, uint32_t lastPass);
+	void allocate();
+	// Frees the memory and forgets the images, they are destroyed by their owner
+	void free();
+
+	// The images sharing some memory with image
+	[[nodiscard]] std::vector<vk::Image> getAliases(vk::Image image) const;
+
+	[[nodiscard]] vk::DeviceSize getAllocatedBytes() const {
+		return m_allocatedBytes;
+	}
+	// What the images would take in separate allocations
+	[[nodiscard]] vk::DeviceSize getRequiredBytes() const;
+
+private:
+	vk::Device m_device;
+	vk::PhysicalDevice m_physicalDevice;
+
+	std::vector<vk::Image> m_images;
+	std::vector<Block> m_blocks;
+	uint32_t m_memoryTypeBits = ~0u;
+	vk::DeviceMemory m_memory;
+	vk::DeviceSize m_allocatedBytes = 0;
+};
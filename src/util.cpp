@@ -1,5 +1,11 @@
 #include "util.h"
+#include "startupTrace.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <queue>
+#include <thread>
 
 extern bool GeneratePointLight;
 extern bool GenerateWhiteLight;
@@ -48,14 +54,150 @@ nvmath::vec3 min, nvmath::vec3 max
 	return result;
 }
 
-std::vector<shader::triangleLight> collectTriangleLights(const nvh::GltfScene& scene) {
+namespace {
+
+// emissive textures are averaged from a low mip, the average over a triangle does not need more detail
+const int EmissiveMipSize = 64;
+const int MaxTriangleSubdivisions = 16;
+// triangles whose texture is darker than this on average are not worth sampling
+const float EmissiveCutoff = 1e-3f;
+
+float srgbToLinear(float c) {
+	return c < 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+// Linear RGB texels of a box filtered mip, sampled bilinearly with repeat like the default sampler
+struct EmissiveMip {
+	int width{ 0 };
+	int height{ 0 };
+	std::vector<nvmath::vec3f> texels;
+
+	[[nodiscard]] nvmath::vec3f sample(float u, float v) const {
+		float x = u * width - 0.5f;
+		float y = v * height - 0.5f;
+		float fx = std::floor(x);
+		float fy = std::floor(y);
+		auto texel = [this](int tx, int ty) {
+			tx = ((tx % width) + width) % width;
+			ty = ((ty % height) + height) % height;
+			return texels[std::size_t(ty) * width + tx];
+		};
+		int x0 = int(fx);
+		int y0 = int(fy);
+		float ax = x - fx;
+		float ay = y - fy;
+		nvmath::vec3f top = texel(x0, y0) * (1.0f - ax) + texel(x0 + 1, y0) * ax;
+		nvmath::vec3f bottom = texel(x0, y0 + 1) * (1.0f - ax) + texel(x0 + 1, y0 + 1) * ax;
+		return top * (1.0f - ay) + bottom * ay;
+	}
+};
+
+EmissiveMip buildEmissiveMip(const tinygltf::Image& image) {
+	EmissiveMip mip;
+	if (image.width <= 0 || image.height <= 0 || image.bits != 8 || image.component < 3 || image.image.empty()) {
+		return mip;
+	}
+	int factor = 1;
+	while (std::max(image.width, image.height) / factor > EmissiveMipSize) {
+		factor *= 2;
+	}
+	mip.width = std::max(1, image.width / factor);
+	mip.height = std::max(1, image.height / factor);
+	mip.texels.resize(std::size_t(mip.width) * mip.height);
+	for (int y = 0; y < mip.height; ++y) {
+		for (int x = 0; x < mip.width; ++x) {
+			nvmath::vec3f sum(0.0f);
+			int count = 0;
+			for (int sy = y * factor; sy < std::min((y + 1) * factor, image.height); ++sy) {
+				for (int sx = x * factor; sx < std::min((x + 1) * factor, image.width); ++sx) {
+					const unsigned char* p = &image.image[(std::size_t(sy) * image.width + sx) * image.component];
+					sum += nvmath::vec3f(srgbToLinear(p[0] / 255.0f), srgbToLinear(p[1] / 255.0f), srgbToLinear(p[2] / 255.0f));
+					++count;
+				}
+			}
+			mip.texels[std::size_t(y) * mip.width + x] = sum / float(std::max(count, 1));
+		}
+	}
+	return mip;
+}
+
+// Stratified average over the triangle: n * n sub-triangles of equal area, n grows with the texels covered
+nvmath::vec3f averageEmission(const EmissiveMip& mip, const nvmath::vec2f uv[3]) {
+	nvmath::vec2f e1 = uv[1] - uv[0];
+	nvmath::vec2f e2 = uv[2] - uv[0];
+	float texels = 0.5f * std::abs(e1.x * e2.y - e1.y * e2.x) * float(mip.width) * float(mip.height);
+	int n = std::clamp(int(std::ceil(std::sqrt(texels))), 1, MaxTriangleSubdivisions);
+
+	nvmath::vec3f sum(0.0f);
+	auto add = [&](float b1, float b2) {
+		nvmath::vec2f p = uv[0] + e1 * b1 + e2 * b2;
+		sum += mip.sample(p.x, p.y);
+	};
+	for (int i = 0; i < n; ++i) {
+		for (int j = 0; i + j < n; ++j) {
+			add((i + 1.0f / 3.0f) / n, (j + 1.0f / 3.0f) / n);
+			if (i + j < n - 1) {
+				add((i + 2.0f / 3.0f) / n, (j + 2.0f / 3.0f) / n);
+			}
+		}
+	}
+	return sum / float(n * n);
+}
+
+template <typename Func>
+void parallelFor(const char* name, std::size_t count, Func&& func) {
+	const std::size_t chunk = 64;
+	std::atomic<std::size_t> next{ 0 };
+	std::vector<std::thread> threads(std::max(1u, std::thread::hardware_concurrency()));
+	for (std::thread& thread : threads) {
+		thread = std::thread([&]() {
+			StartupTrace::Zone zone(name);
+			for (std::size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk)) {
+				for (std::size_t i = begin; i < std::min(begin + chunk, count); ++i) {
+					func(i);
+				}
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+}  // namespace
+
+std::vector<shader::triangleLight> collectTriangleLights(const nvh::GltfScene& scene, const tinygltf::Model& tmodel) {
+	// low mips of the emissive textures, indexed like the glTF textures
+	std::vector<int> emissiveTextures;
+	for (const nvh::GltfMaterial& material : scene.m_materials) {
+		int texture = material.emissiveTexture;
+		if (texture >= 0 && texture < int(tmodel.textures.size())
+			&& std::find(emissiveTextures.begin(), emissiveTextures.end(), texture) == emissiveTextures.end()) {
+			emissiveTextures.push_back(texture);
+		}
+	}
+	std::vector<EmissiveMip> mips(tmodel.textures.size());
+	parallelFor("Emissive Mips", emissiveTextures.size(), [&](std::size_t i) {
+		int source = tmodel.textures[emissiveTextures[i]].source;
+		if (source >= 0 && source < int(tmodel.images.size())) {
+			mips[emissiveTextures[i]] = buildEmissiveMip(tmodel.images[source]);
+		}
+	});
+
 	std::vector<shader::triangleLight> result;
+	std::vector<std::array<nvmath::vec2f, 3>> texcoords;
+	std::vector<const EmissiveMip*> triangleMips;
 	for (const nvh::GltfNode& node : scene.m_nodes) {
 		const nvh::GltfPrimMesh& mesh = scene.m_primMeshes[node.primMesh];
 		const nvh::GltfMaterial& material = scene.m_materials[mesh.materialIndex];
 		if (material.emissiveFactor.sq_norm() > 1e-6) {
 			const uint32_t* indices = scene.m_indices.data() + mesh.firstIndex;
 			const nvmath::vec3* pos = scene.m_positions.data() + mesh.vertexOffset;
+			const EmissiveMip* mip = nullptr;
+			if (material.emissiveTexture >= 0 && material.emissiveTexture < int(mips.size())
+				&& !mips[material.emissiveTexture].texels.empty() && scene.m_texcoords0.size() >= scene.m_positions.size()) {
+				mip = &mips[material.emissiveTexture];
+			}
 			for (uint32_t i = 0; i < mesh.indexCount; i += 3, indices += 3) {
 				// triangle
 				vec4 p1 = node.worldMatrix * nvmath::vec4(pos[indices[0]], 1.0f);
@@ -72,15 +214,51 @@ std::vector<shader::triangleLight> collectTriangleLights(const nvh::GltfScene& s
 					material.emissiveFactor.x, material.emissiveFactor.y, material.emissiveFactor.z
 				);
 
-				shader::triangleLight tmpTriLight{ p1, p2, p3, vec4(material.emissiveFactor, 0.0), area };
 				result.push_back(shader::triangleLight{
 					p1, p2, p3,
 					 nvmath::vec4(material.emissiveFactor, emissionLuminance),
 					 nvmath::vec4(normal, area)
 					});
+
+				// texture coordinates with the material's uv transform, as in restir.rchit
+				std::array<nvmath::vec2f, 3>& uv = texcoords.emplace_back();
+				if (mip != nullptr) {
+					const nvmath::vec2f* tex = scene.m_texcoords0.data() + mesh.vertexOffset;
+					for (int v = 0; v < 3; ++v) {
+						nvmath::vec4f t(tex[indices[v]].x, tex[indices[v]].y, 1.0f, 1.0f);
+						uv[v] = nvmath::vec2f(nvmath::dot(t, material.uvTransform.col(0)), nvmath::dot(t, material.uvTransform.col(1)));
+					}
+				}
+				triangleMips.push_back(mip);
 			}
 		}
 	}
+
+	std::vector<char> dark(result.size(), 0);
+	parallelFor("Triangle Light Emission", result.size(), [&](std::size_t i) {
+		if (triangleMips[i] == nullptr) {
+			return;
+		}
+		nvmath::vec3f average = averageEmission(*triangleMips[i], texcoords[i].data());
+		if (shader::luminance(average.x, average.y, average.z) < EmissiveCutoff) {
+			dark[i] = 1;
+			return;
+		}
+		vec4& emission = result[i].emission_luminance;
+		emission = nvmath::vec4(emission.x * average.x, emission.y * average.y, emission.z * average.z, 0.0f);
+		emission.w = shader::luminance(emission.x, emission.y, emission.z);
+	});
+
+	std::size_t kept = 0;
+	for (std::size_t i = 0; i < result.size(); ++i) {
+		if (!dark[i]) {
+			result[kept++] = result[i];
+		}
+	}
+	if (kept != result.size()) {
+		std::cout << "Dark Emissive Triangles Dropped: " << result.size() - kept << std::endl;
+	}
+	result.resize(kept);
 	return result;
 }
 
@@ -1,5 +1,5 @@
 #pragma once
-#define NVVK_ALLOC_DEDICATED
+#define NVVK_ALLOC_DMA
 
 #include <vulkan/vulkan.hpp>
 #include <nvmath/nvmath.h>
@@ -24,7 +24,9 @@
 	nvmath::vec3 min, nvmath::vec3 max
 );
 
-[[nodiscard]] std::vector<shader::triangleLight> collectTriangleLights(const nvh::GltfScene&);
+// Triangles of emissive materials, with the emission averaged over the emissive texture.
+// Triangles that are almost black in the texture are left out.
+[[nodiscard]] std::vector<shader::triangleLight> collectTriangleLights(const nvh::GltfScene&, const tinygltf::Model&);
 
 [[nodiscard]] std::vector<shader::aliasTableCell> createAliasTable(std::vector<float>&);
 
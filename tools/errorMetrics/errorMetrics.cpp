@@ -0,0 +1,325 @@
+// Compares convergence captures against their reference.
+//
+//   restir_error_metrics <convergence dir>      reads reference.pfm and captures.csv, writes errors.csv
+//   restir_error_metrics <reference> <test>     prints the errors of a single image
+//
+// Reported metrics: MSE, relative MSE (squared error over squared reference plus 0.01)
+// and the mean of a FLIP style perceptual error computed on Reinhard tonemapped images.
+#include "../../src/pfm.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Errors {
+	double mse{ 0.0 };
+	double relMse{ 0.0 };
+	double flip{ 0.0 };
+};
+
+struct Vec3 {
+	float x{ 0.0f }, y{ 0.0f }, z{ 0.0f };
+};
+
+// Monitor viewed at 0.7m, 0.7m wide, 3840 pixels
+const float PixelsPerDegree = 67.0206f;
+const float Qc = 0.7f;
+const float Qf = 0.5f;
+const float Pc = 0.4f;
+const float Pt = 0.95f;
+
+Vec3 linearRgbToXyz(Vec3 c) {
+	return { 0.4124564f * c.x + 0.3575761f * c.y + 0.1804375f * c.z,
+		0.2126729f * c.x + 0.7151522f * c.y + 0.0721750f * c.z,
+		0.0193339f * c.x + 0.1191920f * c.y + 0.9503041f * c.z };
+}
+
+Vec3 xyzToLinearRgb(Vec3 c) {
+	return { 3.2404542f * c.x - 1.5371385f * c.y - 0.4985314f * c.z,
+		-0.9692660f * c.x + 1.8760108f * c.y + 0.0415560f * c.z,
+		0.0556434f * c.x - 0.2040259f * c.y + 1.0572252f * c.z };
+}
+
+const Vec3 WhitePoint = linearRgbToXyz({ 1.0f, 1.0f, 1.0f });
+
+Vec3 xyzToYcxcz(Vec3 c) {
+	float x = c.x / WhitePoint.x, y = c.y / WhitePoint.y, z = c.z / WhitePoint.z;
+	return { 116.0f * y - 16.0f, 500.0f * (x - y), 200.0f * (y - z) };
+}
+
+Vec3 ycxczToXyz(Vec3 c) {
+	float y = (c.x + 16.0f) / 116.0f;
+	return { (y + c.y / 500.0f) * WhitePoint.x, y * WhitePoint.y, (y - c.z / 200.0f) * WhitePoint.z };
+}
+
+Vec3 xyzToLab(Vec3 c) {
+	auto f = [](float t) {
+		const float delta = 6.0f / 29.0f;
+		return t > delta * delta * delta ? std::cbrt(t) : t / (3.0f * delta * delta) + 4.0f / 29.0f;
+	};
+	float x = f(c.x / WhitePoint.x), y = f(c.y / WhitePoint.y), z = f(c.z / WhitePoint.z);
+	return { 116.0f * y - 16.0f, 500.0f * (x - y), 200.0f * (y - z) };
+}
+
+Vec3 hunt(Vec3 lab) {
+	return { lab.x, 0.01f * lab.x * lab.y, 0.01f * lab.x * lab.z };
+}
+
+float hyab(Vec3 a, Vec3 b) {
+	float dl = a.x - b.x, da = a.y - b.y, db = a.z - b.z;
+	return std::abs(dl) + std::sqrt(da * da + db * db);
+}
+
+// Reinhard tonemapping to [0,1] linear RGB
+std::vector<Vec3> toneMap(const PfmImage& image) {
+	std::vector<Vec3> result(size_t(image.width) * image.height);
+	for (size_t i = 0; i < result.size(); ++i) {
+		auto map = [](float v) { v = std::max(v, 0.0f); return v / (1.0f + v); };
+		result[i] = { map(image.rgb[3 * i]), map(image.rgb[3 * i + 1]), map(image.rgb[3 * i + 2]) };
+	}
+	return result;
+}
+
+// Normalized 1D Gaussian weights (or its derivatives) sampled over a radius of 3 sigma
+std::vector<float> gaussianKernel(float sigma, int order) {
+	int radius = std::max(1, int(std::ceil(3.0f * sigma)));
+	std::vector<float> weights(2 * radius + 1);
+	float sum = 0.0f;
+	for (int i = -radius; i <= radius; ++i) {
+		float g = std::exp(-float(i * i) / (2.0f * sigma * sigma));
+		weights[i + radius] = g;
+		sum += g;
+	}
+	for (int i = -radius; i <= radius; ++i) {
+		float g = weights[i + radius] / sum;
+		if (order == 1) {
+			g *= -float(i) / (sigma * sigma);
+		}
+		else if (order == 2) {
+			g *= (float(i * i) / (sigma * sigma) - 1.0f) / (sigma * sigma);
+		}
+		weights[i + radius] = g;
+	}
+	if (order > 0) {
+		// zero the DC response and keep a unit positive lobe
+		float positive = 0.0f, mean = 0.0f;
+		for (float w : weights) mean += w;
+		mean /= float(weights.size());
+		for (float& w : weights) {
+			w -= order == 2 ? mean : 0.0f;
+			positive += std::max(w, 0.0f);
+		}
+		for (float& w : weights) w /= positive;
+	}
+	return weights;
+}
+
+// Separable convolution with clamped borders
+std::vector<float> convolve(const std::vector<float>& src, uint32_t width, uint32_t height,
+	const std::vector<float>& kernelX, const std::vector<float>& kernelY) {
+	std::vector<float> tmp(src.size()), dst(src.size());
+	int rx = int(kernelX.size() / 2), ry = int(kernelY.size() / 2);
+	for (int y = 0; y < int(height); ++y) {
+		for (int x = 0; x < int(width); ++x) {
+			float sum = 0.0f;
+			for (int k = -rx; k <= rx; ++k) {
+				int sx = std::clamp(x + k, 0, int(width) - 1);
+				sum += kernelX[k + rx] * src[size_t(y) * width + sx];
+			}
+			tmp[size_t(y) * width + x] = sum;
+		}
+	}
+	for (int y = 0; y < int(height); ++y) {
+		for (int x = 0; x < int(width); ++x) {
+			float sum = 0.0f;
+			for (int k = -ry; k <= ry; ++k) {
+				int sy = std::clamp(y + k, 0, int(height) - 1);
+				sum += kernelY[k + ry] * tmp[size_t(sy) * width + x];
+			}
+			dst[size_t(y) * width + x] = sum;
+		}
+	}
+	return dst;
+}
+
+// Contrast sensitivity filtering in YCxCz, approximated by a sum of Gaussians per channel
+std::vector<Vec3> spatialFilter(const std::vector<Vec3>& ycxcz, uint32_t width, uint32_t height) {
+	struct Csf { float a1, b1, a2, b2; };
+	const Csf csf[3] = { { 1.0f, 0.0047f, 0.0f, 1e-5f }, { 1.0f, 0.0053f, 0.0f, 1e-5f }, { 34.1f, 0.04f, 13.5f, 0.025f } };
+	const float pi = 3.14159265f;
+	std::vector<Vec3> filtered(ycxcz.size());
+	for (int c = 0; c < 3; ++c) {
+		std::vector<float> channel(ycxcz.size());
+		for (size_t i = 0; i < ycxcz.size(); ++i) {
+			channel[i] = c == 0 ? ycxcz[i].x : (c == 1 ? ycxcz[i].y : ycxcz[i].z);
+		}
+		// a * sqrt(pi / b) * exp(-pi^2 x^2 / b) is a Gaussian with sigma = sqrt(b / 2) / pi, in degrees
+		std::vector<float> result(channel.size(), 0.0f);
+		float terms[2][2] = { { csf[c].a1, csf[c].b1 }, { csf[c].a2, csf[c].b2 } };
+		float totalWeight = 0.0f;
+		for (auto& term : terms) {
+			if (term[0] == 0.0f) {
+				continue;
+			}
+			float sigma = std::sqrt(term[1] / 2.0f) / pi * PixelsPerDegree;
+			float weight = term[0] * std::sqrt(pi / term[1]) * sigma * std::sqrt(2.0f * pi) / PixelsPerDegree;
+			std::vector<float> kernel = gaussianKernel(std::max(sigma, 0.3f), 0);
+			std::vector<float> blurred = convolve(channel, width, height, kernel, kernel);
+			for (size_t i = 0; i < result.size(); ++i) result[i] += weight * blurred[i];
+			totalWeight += weight;
+		}
+		for (size_t i = 0; i < result.size(); ++i) {
+			float value = result[i] / totalWeight;
+			(c == 0 ? filtered[i].x : (c == 1 ? filtered[i].y : filtered[i].z)) = value;
+		}
+	}
+	return filtered;
+}
+
+std::vector<float> colorDifference(const std::vector<Vec3>& reference, const std::vector<Vec3>& test,
+	uint32_t width, uint32_t height) {
+	auto prepare = [&](const std::vector<Vec3>& image) {
+		std::vector<Vec3> ycxcz(image.size());
+		for (size_t i = 0; i < image.size(); ++i) ycxcz[i] = xyzToYcxcz(linearRgbToXyz(image[i]));
+		std::vector<Vec3> filtered = spatialFilter(ycxcz, width, height);
+		for (Vec3& c : filtered) {
+			Vec3 rgb = xyzToLinearRgb(ycxczToXyz(c));
+			rgb = { std::clamp(rgb.x, 0.0f, 1.0f), std::clamp(rgb.y, 0.0f, 1.0f), std::clamp(rgb.z, 0.0f, 1.0f) };
+			c = hunt(xyzToLab(linearRgbToXyz(rgb)));
+		}
+		return filtered;
+	};
+	std::vector<Vec3> ref = prepare(reference);
+	std::vector<Vec3> tst = prepare(test);
+
+	float cmax = std::pow(hyab(hunt(xyzToLab(linearRgbToXyz({ 0.0f, 1.0f, 0.0f }))),
+		hunt(xyzToLab(linearRgbToXyz({ 0.0f, 0.0f, 1.0f })))), Qc);
+	std::vector<float> difference(ref.size());
+	for (size_t i = 0; i < ref.size(); ++i) {
+		float e = std::pow(hyab(ref[i], tst[i]), Qc);
+		difference[i] = e < Pc * cmax ? Pt / (Pc * cmax) * e
+			: Pt + (e - Pc * cmax) / (cmax - Pc * cmax) * (1.0f - Pt);
+	}
+	return difference;
+}
+
+std::vector<float> featureDifference(const std::vector<Vec3>& reference, const std::vector<Vec3>& test,
+	uint32_t width, uint32_t height) {
+	float sigma = 0.5f * 0.082f * PixelsPerDegree;
+	std::vector<float> g0 = gaussianKernel(sigma, 0), g1 = gaussianKernel(sigma, 1), g2 = gaussianKernel(sigma, 2);
+	auto features = [&](const std::vector<Vec3>& image, std::vector<float>& edge, std::vector<float>& point) {
+		std::vector<float> luma(image.size());
+		for (size_t i = 0; i < image.size(); ++i) {
+			luma[i] = (linearRgbToXyz(image[i]).y / WhitePoint.y * 116.0f - 16.0f) / 100.0f;
+		}
+		std::vector<float> ex = convolve(luma, width, height, g1, g0), ey = convolve(luma, width, height, g0, g1);
+		std::vector<float> px = convolve(luma, width, height, g2, g0), py = convolve(luma, width, height, g0, g2);
+		edge.resize(luma.size());
+		point.resize(luma.size());
+		for (size_t i = 0; i < luma.size(); ++i) {
+			edge[i] = std::sqrt(ex[i] * ex[i] + ey[i] * ey[i]);
+			point[i] = std::sqrt(px[i] * px[i] + py[i] * py[i]);
+		}
+	};
+	std::vector<float> refEdge, refPoint, testEdge, testPoint;
+	features(reference, refEdge, refPoint);
+	features(test, testEdge, testPoint);
+	std::vector<float> difference(refEdge.size());
+	for (size_t i = 0; i < difference.size(); ++i) {
+		float d = std::max(std::abs(refEdge[i] - testEdge[i]), std::abs(refPoint[i] - testPoint[i]));
+		difference[i] = std::pow(d / std::sqrt(2.0f), Qf);
+	}
+	return difference;
+}
+
+bool computeErrors(const PfmImage& reference, const PfmImage& test, Errors& errors) {
+	if (reference.width != test.width || reference.height != test.height) {
+		std::cerr << "Image sizes do not match" << std::endl;
+		return false;
+	}
+	double mse = 0.0, relMse = 0.0;
+	for (size_t i = 0; i < reference.rgb.size(); ++i) {
+		double r = reference.rgb[i], t = test.rgb[i];
+		double d = (t - r) * (t - r);
+		mse += d;
+		relMse += d / (r * r + 0.01);
+	}
+	errors.mse = mse / double(reference.rgb.size());
+	errors.relMse = relMse / double(reference.rgb.size());
+
+	std::vector<Vec3> ref = toneMap(reference), tst = toneMap(test);
+	std::vector<float> deltaE = colorDifference(ref, tst, reference.width, reference.height);
+	std::vector<float> deltaF = featureDifference(ref, tst, reference.width, reference.height);
+	double flip = 0.0;
+	for (size_t i = 0; i < deltaE.size(); ++i) {
+		flip += std::pow(deltaE[i], 1.0f - deltaF[i]);
+	}
+	errors.flip = flip / double(deltaE.size());
+	return true;
+}
+
+bool loadImage(const std::string& filename, PfmImage& image) {
+	if (!readPfm(filename, image)) {
+		std::cerr << "Cannot read " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+int compareDirectory(const std::string& directory) {
+	PfmImage reference;
+	if (!loadImage(directory + "/reference.pfm", reference)) {
+		return -1;
+	}
+	std::ifstream captures(directory + "/captures.csv");
+	std::ofstream output(directory + "/errors.csv");
+	if (!captures || !output) {
+		std::cerr << "Cannot open captures.csv or errors.csv in " << directory << std::endl;
+		return -1;
+	}
+	output << "config,frame,gpuMs,mse,relMse,flip\n";
+	std::string line;
+	std::getline(captures, line);
+	while (std::getline(captures, line)) {
+		std::stringstream fields(line);
+		std::string config, frame, gpuMs, file;
+		if (!std::getline(fields, config, ',') || !std::getline(fields, frame, ',')
+			|| !std::getline(fields, gpuMs, ',') || !std::getline(fields, file, ',')) {
+			continue;
+		}
+		PfmImage test;
+		Errors errors;
+		if (!loadImage(directory + "/" + file, test) || !computeErrors(reference, test, errors)) {
+			return -1;
+		}
+		output << config << "," << frame << "," << gpuMs << "," << errors.mse << "," << errors.relMse << "," << errors.flip << "\n";
+		std::cout << config << " frame " << frame << " (" << gpuMs << " ms): relMSE " << errors.relMse
+			<< ", FLIP " << errors.flip << std::endl;
+	}
+	return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+	if (argc == 2) {
+		return compareDirectory(argv[1]);
+	}
+	if (argc == 3) {
+		PfmImage reference, test;
+		Errors errors;
+		if (!loadImage(argv[1], reference) || !loadImage(argv[2], test) || !computeErrors(reference, test, errors)) {
+			return -1;
+		}
+		std::cout << "MSE " << errors.mse << "\nrelMSE " << errors.relMse << "\nFLIP " << errors.flip << std::endl;
+		return 0;
+	}
+	std::cerr << "Usage: " << argv[0] << " <convergence dir> | <reference.pfm> <test.pfm>" << std::endl;
+	return -1;
+}